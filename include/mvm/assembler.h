@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include "mvm/code_sink.h"
 #include "mvm/concept.h"
 #include "mvm/except.h"
 #include "mvm/instr_set.h"
@@ -23,10 +24,21 @@
 #include "mvm/trace.h"
 #include "mvm/traits.h"
 
+#ifndef _WIN32
+#include "mvm/mapped_file.h"
+#endif
+
 #include <algorithm>
+#include <array>
+#include <cctype>
 #include <cstdint>
+#include <exception>
+#include <istream>
 #include <iterator>
-#include <sstream>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
@@ -35,8 +47,9 @@ namespace mvm {
 ///
 /// @brief Basic assembler
 ///
-/// The implementation is not focused on performance but
-/// on educational purpose.
+/// Lines are tokenized in place in the source buffer. Chunks are written
+/// in place, the bytecode of each instruction is otherwise handed over to
+/// a code sink as soon as it is built.
 ///
 template <typename Set, typename MetaCodeImpl> class assembler {
   using instr_set_type = Set;
@@ -54,25 +67,120 @@ public:
   ///
   prog_chunk assemble(std::istream &stream) const;
 
+  ///
+  /// @brief Assemble code chunk, all buffers allocating from a memory resource
+  ///
+  pmr::prog_chunk assemble(std::istream &stream,
+                           std::pmr::memory_resource *res) const;
+
+  ///
+  /// @brief Assemble code chunk from a source buffer
+  ///
+  prog_chunk assemble(std::string_view source) const;
+
+  ///
+  /// @brief Assemble code chunk from a source buffer, the chunk allocating
+  /// from a memory resource
+  ///
+  pmr::prog_chunk assemble(std::string_view source,
+                           std::pmr::memory_resource *res) const;
+
+  ///
+  /// @brief Assemble code chunk from a source buffer split at line
+  /// boundaries, pieces being assembled on several threads
+  ///
+  /// @param jobs max number of threads, hardware concurrency if 0
+  ///
+  prog_chunk assemble_parallel(std::string_view source,
+                               std::size_t jobs = 0) const;
+
+  // smallest source piece worth a thread
+  static constexpr std::size_t min_piece_size = std::size_t{1} << 16;
+
+  ///
+  /// @brief Assemble a source buffer instruction by instruction into a
+  /// code sink
+  ///
+  template <typename Sink>
+  void assemble_to(std::string_view source, Sink &sink) const;
+
+#ifndef _WIN32
+  ///
+  /// @brief Assemble a memory mapped source file into a code sink
+  ///
+  template <typename Sink>
+  void assemble_file(char const *path, Sink &sink) const {
+    mapped_file source{path};
+    assemble_to(source.view(), sink);
+  }
+#endif
+
 private:
-  // assemble single line
-  std::vector<uint8_t> assemble(std::string const &line) const;
+  template <typename... Is>
+  static constexpr std::size_t max_operand_count(list::mplist<Is...>) {
+    return std::max(
+        {std::size_t{0}, list::size_v<typename Is::bytecode_type>...});
+  }
+
+  static constexpr std::size_t max_instr_length() {
+    std::size_t res{0};
+    for (auto length : instr_set_traits_type::instr_lengths) {
+      res = std::max<std::size_t>(res, length);
+    }
+    return res;
+  }
+
+  // operand tokens of a line, views in the source buffer
+  using tokens_type = std::array<std::string_view,
+                                 max_operand_count(instr_set_desc_type{})>;
+
+  // bytecode of a single instruction
+  struct instr_code {
+    using value_type = std::uint8_t;
+
+    std::array<std::uint8_t, max_instr_length()> bytes;
+    std::size_t size{0};
+
+    void push_back(std::uint8_t b) { bytes[size++] = b; }
+  };
+
+  // call f on each line of a source buffer
+  template <typename F>
+  static void for_each_line(std::string_view source, F &&f) {
+    std::size_t pos{0};
+    while (pos < source.size()) {
+      auto end = std::min(source.find('\n', pos), source.size());
+      f(source.substr(pos, end - pos));
+      pos = end + 1;
+    }
+  }
+
+  // read a whole stream then assemble it
+  template <typename Chunk>
+  void assemble(std::istream &stream, Chunk &c,
+                std::pmr::memory_resource *res) const;
+
+  // assemble all lines of a source buffer into a chunk
+  template <typename Chunk>
+  void assemble(std::string_view source, Chunk &c) const;
+
+  // assemble single line at the end of a bytecode buffer
+  template <typename Code>
+  void assemble_line(std::string_view line, Code &code) const;
 
   // assemble single instruction
-  template <typename I>
-  std::vector<uint8_t>
-  assemble_instr(uint8_t i, std::vector<std::string> const &attributes) const;
+  template <typename I, typename Code>
+  void assemble_instr(std::size_t i, tokens_type const &operands,
+                      std::size_t count, Code &code) const;
 
   // assemble instr operands
-  template <typename I, std::size_t... Is>
-  void assemble_operands(std::vector<uint8_t> &bytes,
-                         std::vector<std::string> const &tokens,
+  template <typename I, typename Code, std::size_t... Is>
+  void assemble_operands(Code &code, tokens_type const &operands,
                          std::index_sequence<Is...>) const;
 
   // serialize operand
-  template <typename I, std::size_t Index>
-  void serial_operand(std::vector<uint8_t> &bytes,
-                      std::string const &token) const;
+  template <typename I, std::size_t Index, typename Code>
+  void serial_operand(Code &code, std::string_view token) const;
 };
 
 ///////////////////////////////////////////////////////////////
@@ -82,122 +190,288 @@ private:
 template <typename Set, typename MetaCodeImpl>
 prog_chunk assembler<Set, MetaCodeImpl>::assemble(std::istream &stream) const {
   prog_chunk c;
-  std::string line;
-  while (std::getline(stream, line)) {
-    auto line_assembly = assemble(line);
-    c.code.insert(std::end(c.code), std::cbegin(line_assembly),
-                  std::cend(line_assembly));
+  assemble(stream, c, std::pmr::new_delete_resource());
+  return c;
+}
+
+template <typename Set, typename MetaCodeImpl>
+pmr::prog_chunk
+assembler<Set, MetaCodeImpl>::assemble(std::istream &stream,
+                                       std::pmr::memory_resource *res) const {
+  pmr::prog_chunk c{pmr::prog_chunk::allocator_type{res}};
+  assemble(stream, c, res);
+  return c;
+}
+
+template <typename Set, typename MetaCodeImpl>
+prog_chunk
+assembler<Set, MetaCodeImpl>::assemble(std::string_view source) const {
+  prog_chunk c;
+  assemble(source, c);
+  return c;
+}
+
+template <typename Set, typename MetaCodeImpl>
+pmr::prog_chunk
+assembler<Set, MetaCodeImpl>::assemble(std::string_view source,
+                                       std::pmr::memory_resource *res) const {
+  pmr::prog_chunk c{pmr::prog_chunk::allocator_type{res}};
+  assemble(source, c);
+  return c;
+}
+
+template <typename Set, typename MetaCodeImpl>
+prog_chunk
+assembler<Set, MetaCodeImpl>::assemble_parallel(std::string_view source,
+                                                std::size_t jobs) const {
+  if (jobs == 0) {
+    jobs = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  auto count = std::min(jobs, std::max(std::size_t{1},
+                                       source.size() / min_piece_size));
+
+  // cut after the first line end following each even split point
+  std::vector<std::string_view> pieces;
+  std::size_t begin{0};
+  for (std::size_t k = 1; k <= count; ++k) {
+    auto end = source.size();
+    if (k < count) {
+      auto split = std::max(begin, k * source.size() / count);
+      end = std::min(source.find('\n', split), source.size() - 1) + 1;
+    }
+    pieces.push_back(source.substr(begin, end - begin));
+    begin = end;
+  }
+
+  std::vector<prog_chunk> chunks(pieces.size());
+  std::vector<std::exception_ptr> errors(pieces.size());
+  auto assemble_piece = [&](std::size_t k) {
+    try {
+      assemble(pieces[k], chunks[k]);
+    } catch (...) {
+      errors[k] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(pieces.size() - 1);
+  try {
+    for (std::size_t k = 1; k < pieces.size(); ++k) {
+      workers.emplace_back(assemble_piece, k);
+    }
+  } catch (...) {
+    // started workers still use the pieces and chunks of this frame
+    for (auto &w : workers) {
+      w.join();
+    }
+    throw;
+  }
+  assemble_piece(0);
+  for (auto &w : workers) {
+    w.join();
   }
 
+  // report the error of the first failing line, as a serial run would
+  for (auto const &e : errors) {
+    if (e) {
+      std::rethrow_exception(e);
+    }
+  }
+
+  // operands never refer to other lines, each piece simply lands at the
+  // sum of the lengths of the previous ones
+  std::size_t size{0};
+  for (auto const &piece : chunks) {
+    size += piece.code.size();
+  }
+
+  prog_chunk c;
+  c.code.reserve(size);
+  for (auto const &piece : chunks) {
+    c.code.insert(std::end(c.code), std::cbegin(piece.code),
+                  std::cend(piece.code));
+  }
   return c;
 }
 
 template <typename Set, typename MetaCodeImpl>
-std::vector<uint8_t>
-assembler<Set, MetaCodeImpl>::assemble(std::string const &line) const {
-  std::istringstream iss(line);
-  std::vector<std::string> tokens(std::istream_iterator<std::string>{iss},
-                                  std::istream_iterator<std::string>());
+template <typename Chunk>
+void assembler<Set, MetaCodeImpl>::assemble(
+    std::istream &stream, Chunk &c, std::pmr::memory_resource *res) const {
+  std::pmr::string source{std::istreambuf_iterator<char>{stream},
+                          std::istreambuf_iterator<char>{}, res};
+  assemble(std::string_view{source}, c);
+}
+
+template <typename Set, typename MetaCodeImpl>
+template <typename Chunk>
+void assembler<Set, MetaCodeImpl>::assemble(std::string_view source,
+                                            Chunk &c) const {
+  // bytecode is rarely longer than its source
+  c.code.reserve(c.code.size() + source.size());
+
+  // operands are serialized straight into the chunk
+  for_each_line(source, [this, &c](std::string_view line) {
+    assemble_line(line, c.code);
+  });
+}
+
+template <typename Set, typename MetaCodeImpl>
+template <typename Sink>
+void assembler<Set, MetaCodeImpl>::assemble_to(std::string_view source,
+                                               Sink &sink) const {
+  for_each_line(source, [this, &sink](std::string_view line) {
+    instr_code code;
+    assemble_line(line, code);
+    sink.write(code.bytes.data(), code.size);
+  });
+}
+
+template <typename Set, typename MetaCodeImpl>
+template <typename Code>
+void assembler<Set, MetaCodeImpl>::assemble_line(std::string_view line,
+                                                 Code &code) const {
+  auto is_space = [](char c) {
+    return std::isspace(static_cast<unsigned char>(c));
+  };
 
-  if (tokens.empty()) // need at leat an instruction name
+  // first token is the instruction name, extra operands are only counted
+  std::string_view name;
+  tokens_type operands;
+  std::size_t count{0};
+  for (auto it = std::cbegin(line); it != std::cend(line);) {
+    auto token_start = std::find_if_not(it, std::cend(line), is_space);
+    it = std::find_if(token_start, std::cend(line), is_space);
+    if (token_start == it) {
+      continue;
+    }
+
+    std::string_view token{&*token_start,
+                           static_cast<std::size_t>(it - token_start)};
+    if (name.empty()) {
+      name = token;
+    } else {
+      if (count < operands.size()) {
+        operands[count] = token;
+      }
+      ++count;
+    }
+  }
+
+  if (name.empty()) // need at leat an instruction name
   {
-    throw mexcept("[-][mvm] no instruction token", status_type::NO_INSTR_NAME);
+    throw_mexcept("[-][mvm] no instruction token", status_type::NO_INSTR_NAME);
   }
 
-  auto iname_it = std::find_if(
-      std::cbegin(instr_set_traits_type::instr_names),
-      std::cend(instr_set_traits_type::instr_names),
-      [&](auto const &val) { return std::string(val) == tokens[0]; });
+  auto instr_index = instr_set_traits_type::instr_index(name);
 
-  if (iname_it == std::cend(instr_set_traits_type::instr_names)) {
-    throw mexcept("[-][mvm] invalid instruction name",
+  if (instr_index == instr_set_traits_type::instr_set_size) {
+    throw_mexcept("[-][mvm] invalid instruction name",
                   status_type::BAD_INSTR_NAME);
   }
 
-  LOG_INFO("assembler -> assemble instruction " << *iname_it);
-
-  std::vector<uint8_t> bytecode;
-  auto instr_index =
-      std::distance(std::cbegin(instr_set_traits_type::instr_names), iname_it);
+  LOG_INFO("assembler -> assemble instruction "
+           << instr_set_traits_type::instr_names[instr_index]);
 
 #ifdef FASTI
 #define MVM_ASSEMBLE_I(n)                                                      \
   case n: {                                                                    \
     using instr_type = list::at_t<n, instr_set_desc_type>;                     \
     if constexpr (!std::is_same_v<instr_type, nonsuch>) {                      \
-      bytecode = assemble_instr<instr_type>(                                   \
-          static_cast<uint8_t>(n),                                             \
-          (tokens.erase(std::begin(tokens)), tokens));                         \
+      assemble_instr<instr_type>(n, operands, count, code);                    \
     } else {                                                                   \
-      throw mexcept("[-][mvm] invalid instruction opcode",                     \
+      throw_mexcept("[-][mvm] invalid instruction opcode",                     \
                     status_type::INVALID_INSTR_OPCODE);                        \
     }                                                                          \
   } break;
+  auto assemble_visited = [&operands, &code, count, instr_index,
+                           this](auto &&arg) {
+    using instr_type = std::decay_t<decltype(arg)>;
+    this->assemble_instr<instr_type>(instr_index, operands, count, code);
+  };
+
   switch (instr_index) {
     MVM_UNROLL_256(MVM_ASSEMBLE_I)
   default:
-    throw mexcept("[-][mvm] instruction opcode overflow",
-                  status_type::INSTR_OPCODE_OVERFLOW);
+    // instructions of extended sets past the switch range
+    instr_set_visitor<instr_set_desc_type>()(instr_index, assemble_visited);
   }
 #else
-  // visitor version suitable for small instruction sets
   instr_set_visitor<instr_set_desc_type>()(
-      instr_index, [&tokens, &bytecode, instr_index, this](auto &&arg) {
+      instr_index, [&operands, &code, count, instr_index, this](auto &&arg) {
         using instr_type = std::decay_t<decltype(arg)>;
-        tokens.erase(std::begin(tokens));
-        bytecode = this->assemble_instr<instr_type>(
-            static_cast<uint8_t>(instr_index), tokens);
+        this->assemble_instr<instr_type>(instr_index, operands, count, code);
       });
 #endif
-
-  return bytecode;
 }
 
 template <typename Set, typename MetaCodeImpl>
-template <typename I>
-std::vector<uint8_t> assembler<Set, MetaCodeImpl>::assemble_instr(
-    uint8_t i, std::vector<std::string> const &attributes) const {
-  std::vector<uint8_t> bytes = {i};
-
+template <typename I, typename Code>
+void assembler<Set, MetaCodeImpl>::assemble_instr(std::size_t i,
+                                                  tokens_type const &operands,
+                                                  std::size_t count,
+                                                  Code &code) const {
   if constexpr (concept ::is_code_consumer<I>()) {
     using cc_type = typename I::bytecode_type;
 
-    if (attributes.size() != list::size_v<cc_type>) {
-      throw mexcept("[-][mvm] invalid instruction operands",
+    if (count != list::size_v<cc_type>) {
+      throw_mexcept("[-][mvm] invalid instruction operands",
                     status_type::BAD_INSTR_OPERAND);
     }
-
-    assemble_operands<I>(bytes, attributes,
-                         std::make_index_sequence<list::size_v<cc_type>>());
   } else {
-    if (attributes.size() != 0) {
-      throw mexcept("[-][mvm] invalid instruction operands",
+    if (count != 0) {
+      throw_mexcept("[-][mvm] invalid instruction operands",
                     status_type::BAD_INSTR_OPERAND);
     }
   }
 
-  return bytes;
+  if (i < instr_set_traits_type::short_opcode_count) {
+    code.push_back(static_cast<uint8_t>(i));
+  } else {
+    code.push_back(instr_set_traits_type::opcode_escape);
+    code.push_back(
+        static_cast<uint8_t>(i - instr_set_traits_type::short_opcode_count));
+  }
+
+  if constexpr (concept ::is_code_consumer<I>()) {
+    using cc_type = typename I::bytecode_type;
+    assemble_operands<I>(code, operands,
+                         std::make_index_sequence<list::size_v<cc_type>>());
+  }
 }
 
 template <typename Set, typename MetaCodeImpl>
-template <typename I, std::size_t... Is>
+template <typename I, typename Code, std::size_t... Is>
 void assembler<Set, MetaCodeImpl>::assemble_operands(
-    std::vector<uint8_t> &bytes, std::vector<std::string> const &tokens,
+    Code &code, tokens_type const &operands,
     std::index_sequence<Is...>) const {
-  LOG_INFO("assembler -> assemble operands " << (tokens[Is] << ...));
-  (serial_operand<I, Is>(bytes, tokens[Is]), ...);
+  LOG_INFO("assembler -> assemble operands"
+           << (... + (" " + std::string(operands[Is]))));
+  (serial_operand<I, Is>(code, operands[Is]), ...);
 }
 
 template <typename Set, typename MetaCodeImpl>
-template <typename I, std::size_t Index>
+template <typename I, std::size_t Index, typename Code>
 void assembler<Set, MetaCodeImpl>::serial_operand(
-    std::vector<uint8_t> &bytes, std::string const &token) const {
+    Code &code, std::string_view token) const {
   using cc_type = typename I::bytecode_type;
-  auto ser = m_serializer.template serial<
-      list::at_t<Index, cc_type>,
-      instr_set_traits_type::template type_size<list::at_t<Index, cc_type>>,
-      typename instr_set_traits_type::template type_endianness<
-          list::at_t<Index, cc_type>>>(token);
-  std::copy(std::cbegin(ser), std::cend(ser), std::back_inserter(bytes));
+  using operand_type = list::at_t<Index, cc_type>;
+  constexpr auto size =
+      instr_set_traits_type::template type_size<operand_type>;
+  using endian_type =
+      typename instr_set_traits_type::template type_endianness<operand_type>;
+
+  using out_type = std::back_insert_iterator<Code>;
+
+  if constexpr (concept ::has_serial_write_v<code_impl_type, operand_type,
+                                             size, endian_type, out_type>) {
+    // operand bytes are stored once, right after the previous ones
+    m_serializer.template write<operand_type, size, endian_type>(
+        token, std::back_inserter(code));
+  } else {
+    auto ser =
+        m_serializer.template serial<operand_type, size, endian_type>(token);
+    std::copy(std::cbegin(ser), std::cend(ser), std::back_inserter(code));
+  }
 }
 } // namespace mvm
\ No newline at end of file
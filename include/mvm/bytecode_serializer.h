@@ -14,17 +14,37 @@
 
 #pragma once
 
+#include "mvm/except.h"
 #include "mvm/helpers/num_parse.h"
 
+#include <array>
+#include <string_view>
+
 namespace mvm {
 
 ///
 /// @brief default implementation of bytecode serializer
 ///
+/// Serializers provide serial, returning the operand bytes, and may
+/// provide write, storing them through an output iterator. The assembler
+/// uses write when available so operands are stored once, in place.
+///
 struct bytecode_serializer {
   template <typename T, std::size_t N, typename Endian>
-  auto serial(std::string const &str) const {
-    return num::serial<T, N, Endian>(str);
+  auto serial(std::string_view str) const {
+    std::array<uint8_t, N> res;
+    write<T, N, Endian>(str, res.begin());
+    return res;
+  }
+
+  template <typename T, std::size_t N, typename Endian, typename OutputIt>
+  OutputIt write(std::string_view str, OutputIt out) const {
+    auto val = num::parse_number<T, N>(str);
+    if (MVM_UNLIKELY(!val)) {
+      throw_mexcept("[-][mvm] invalid instruction operand",
+                    status_type::BAD_INSTR_OPERAND);
+    }
+    return num::serial_into<T, N, Endian>(*val, out);
   }
 
   template <typename T, std::size_t N, typename Endian>
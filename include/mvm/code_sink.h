@@ -0,0 +1,63 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "mvm/except.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <ostream>
+
+namespace mvm {
+
+//
+// A code sink receives the bytecode of each assembled instruction in
+// order through write(std::uint8_t const *data, std::size_t size). Any
+// type with this member can be used, a ring buffer for instance.
+//
+
+///
+/// @brief Sink appending bytecode to a growable buffer
+///
+template <typename Code> class buffer_sink {
+  Code &m_code;
+
+public:
+  explicit buffer_sink(Code &code) : m_code{code} {}
+
+  void write(std::uint8_t const *data, std::size_t size) {
+    m_code.insert(std::end(m_code), data, data + size);
+  }
+};
+
+///
+/// @brief Sink writing bytecode to an output stream, a file for instance
+///
+class stream_sink {
+  std::ostream &m_os;
+
+public:
+  explicit stream_sink(std::ostream &os) : m_os{os} {}
+
+  void write(std::uint8_t const *data, std::size_t size) {
+    m_os.write(reinterpret_cast<char const *>(data),
+               static_cast<std::streamsize>(size));
+    if (MVM_UNLIKELY(!m_os)) {
+      throw_mexcept("[-][mvm] cannot write bytecode", status_type::IO_ERROR);
+    }
+  }
+};
+} // namespace mvm
@@ -18,6 +18,12 @@
 #include "mvm/helpers/reflect.h"
 #include "mvm/meta.h"
 
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
 // TODO: To be removed in the future
 namespace mvm::concept {
   template <typename T> struct requires_t {
@@ -36,7 +42,8 @@ namespace mvm::concept {
   template <typename T>
   inline constexpr bool is_container_valid_v =
       reflect::has_iterator(reflect::type<T>) &&
-      reflect::has_value_type(reflect::type<T>);
+      reflect::has_value_type(reflect::type<T>) &&
+      !reflect::is_specialization_of_v<std::basic_string, T>;
 
   template <typename T>
   inline constexpr bool is_iterable_consumer_v =
@@ -60,7 +67,41 @@ namespace mvm::concept {
 
   template <typename I> inline constexpr bool is_ip_udpater_v = I::doUpdateIp;
 
+  template <typename I> inline constexpr bool is_pipe_v = I::isPipe;
+
+  template <typename I> inline constexpr bool is_in_place_v = I::isInPlace;
+
+  // stacks able to replace their top values also provide peek
+  template <typename T>
+  inline constexpr bool is_in_place_stack_v =
+      reflect::has_replace(reflect::type<T>, std::size_t{}, int{});
+
+  template <typename T>
+  inline constexpr bool is_profiled_stack_v =
+      reflect::has_high_water_mark(reflect::type<T>);
+
+  template <typename S, typename T, typename N, typename Endian, typename It>
+  using serial_write_t =
+      decltype(std::declval<S const &>().template write<T, N::value, Endian>(
+          std::declval<std::string_view>(), std::declval<It>()));
+
+  // serializers able to store operands through an output iterator
+  template <typename S, typename T, std::size_t N, typename Endian,
+            typename It>
+  inline constexpr bool has_serial_write_v =
+      reflect::is_detected_v<serial_write_t, S, T,
+                             std::integral_constant<std::size_t, N>, Endian,
+                             It>;
+
   template <template <typename> typename Meta>
   inline constexpr bool is_meta_bytecode_v =
       reflect::is_same_meta_v<Meta, meta_bytecode>;
+
+  template <template <typename> typename Meta>
+  inline constexpr bool is_meta_register_file_v =
+      reflect::is_same_meta_v<Meta, meta_register_file>;
+
+  template <typename T>
+  inline constexpr bool is_code_reg_v =
+      reflect::is_specialization_of_v<code_reg, T>;
 } // namespace mvm::concept
\ No newline at end of file
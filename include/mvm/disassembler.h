@@ -42,7 +42,8 @@ public:
   ///
   /// @brief Disassemble code chunk
   ///
-  std::string disassemble(prog_chunk const &c);
+  template <typename Alloc>
+  std::string disassemble(basic_prog_chunk<Alloc> const &c);
 
 private:
   // internal disassemble method
@@ -51,6 +52,9 @@ private:
   // disassemble instr
   template <typename I> std::string disassemble_instr();
 
+  // disassemble instr with a two byte opcode
+  std::string disassemble_extended();
+
   // dissassemble instr operands
   template <typename I, std::size_t... Is>
   void disassemble_operands(std::string &instr, std::index_sequence<Is...>);
@@ -69,8 +73,9 @@ private:
 ///////////////////////////////////////////////////////////////
 
 template <typename Set, typename MetaCodeImpl>
-std::string
-disassembler<Set, MetaCodeImpl>::disassemble(prog_chunk const &chunk) {
+template <typename Alloc>
+std::string disassembler<Set, MetaCodeImpl>::disassemble(
+    basic_prog_chunk<Alloc> const &chunk) {
   m_rebased_ip.rebase(&(chunk.code[0]),
                       &(chunk.code[0]) + chunk.code.size() - 1);
   return this->disassemble();
@@ -87,10 +92,13 @@ std::string disassembler<Set, MetaCodeImpl>::disassemble() {
 #define MVM_DISASSEMBLER_I(n)                                                  \
   case n: {                                                                    \
     using instr_type = list::at_t<n, instr_set_desc_type>;                     \
-    if constexpr (!std::is_same_v<instr_type, nonsuch>) {                      \
+    if constexpr (instr_set_traits_type::is_extended &&                        \
+                  n == instr_set_traits_type::opcode_escape) {                 \
+      prog.append(this->disassemble_extended() + "\n");                        \
+    } else if constexpr (!std::is_same_v<instr_type, nonsuch>) {               \
       prog.append(this->disassemble_instr<instr_type>() + "\n");               \
     } else {                                                                   \
-      throw mexcept("[-][mvm] invalid instruction opcode",                     \
+      throw_mexcept("[-][mvm] invalid instruction opcode",                     \
                     status_type::INVALID_INSTR_OPCODE);                        \
     }                                                                          \
   } break;
@@ -98,15 +106,20 @@ std::string disassembler<Set, MetaCodeImpl>::disassemble() {
     switch (*m_rebased_ip) {
       MVM_UNROLL_256(MVM_DISASSEMBLER_I)
     default:
-      throw mexcept("[-][mvm] instruction opcode overflow",
+      throw_mexcept("[-][mvm] instruction opcode overflow",
                     status_type::INSTR_OPCODE_OVERFLOW);
     }
 #else
-    instr_set_visitor<instr_set_desc_type>()(
-        *m_rebased_ip, [this, &prog](auto &&arg) {
-          using instr_type = std::decay_t<decltype(arg)>;
-          prog.append(this->disassemble_instr<instr_type>() + "\n");
-        });
+    if (instr_set_traits_type::is_extended &&
+        *m_rebased_ip == instr_set_traits_type::opcode_escape) {
+      prog.append(this->disassemble_extended() + "\n");
+    } else {
+      instr_set_visitor<instr_set_desc_type>()(
+          *m_rebased_ip, [this, &prog](auto &&arg) {
+            using instr_type = std::decay_t<decltype(arg)>;
+            prog.append(this->disassemble_instr<instr_type>() + "\n");
+          });
+    }
 #endif
     ++m_rebased_ip;
   }
@@ -114,6 +127,23 @@ std::string disassembler<Set, MetaCodeImpl>::disassemble() {
   return prog;
 }
 
+template <typename Set, typename MetaCodeImpl>
+std::string disassembler<Set, MetaCodeImpl>::disassemble_extended() {
+  ++m_rebased_ip;
+  if (!m_rebased_ip.assert_in_chunk()) {
+    throw_mexcept("[-][mvm] bytecode overflow", status_type::CODE_OVERFLOW);
+  }
+
+  std::string instr;
+  instr_set_visitor<instr_set_desc_type>()(
+      instr_set_traits_type::short_opcode_count + *m_rebased_ip,
+      [this, &instr](auto &&arg) {
+        using instr_type = std::decay_t<decltype(arg)>;
+        instr = this->disassemble_instr<instr_type>();
+      });
+  return instr;
+}
+
 template <typename Set, typename MetaCodeImpl>
 template <typename I>
 std::string disassembler<Set, MetaCodeImpl>::disassemble_instr() {
@@ -160,7 +190,7 @@ void disassembler<Set, MetaCodeImpl>::parse(std::string &instr) {
   m_rebased_ip += N;
 
   if (!m_rebased_ip.assert_in_chunk()) {
-    throw mexcept("[-][mvm] bytecode overflow", status_type::CODE_OVERFLOW);
+    throw_mexcept("[-][mvm] bytecode overflow", status_type::CODE_OVERFLOW);
   }
 
   instr.append(
@@ -14,6 +14,7 @@
 
 #pragma once
 
+#include "mvm/macros.h"
 #include "mvm/status.h"
 
 #include <exception>
@@ -38,6 +39,17 @@ private:
   status_type m_status;
 };
 
+///
+/// @brief Throw an internal exception
+///
+/// Kept out of line so that callers only pay for a call on their failure
+/// path and the message string is never built in hot code.
+///
+[[noreturn]] MVM_COLD inline void throw_mexcept(char const *msg,
+                                                status_type s) {
+  throw mexcept(msg, s);
+}
+
 namespace details {
 template <typename Callable, typename R = std::invoke_result_t<Callable>>
 struct translate_imp {
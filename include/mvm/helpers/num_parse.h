@@ -15,15 +15,29 @@
 #pragma once
 
 #include <array>
-#include <cmath>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
 #include <cstdint>
-#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
 #include <type_traits>
 
 namespace mvm::num {
 struct little_endian_tag {};
 struct big_endian_tag {};
 
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+using native_endian_tag = big_endian_tag;
+#else
+using native_endian_tag = little_endian_tag;
+#endif
+
 namespace details {
 // utility struct used to bytify and set endianness for input and output data
 // note that internal endiannes is le
@@ -49,20 +63,208 @@ template <size_t N, typename E> struct to_endian<N, E, E> {
   }
 };
 
-inline int base(std::string const str) {
-  if (str.find_first_of("0x") == 0) {
-    return 16;
+// object representation copy, std::bit_cast before C++20
+template <typename To, typename From> To bit_cast(From const &from) noexcept {
+  static_assert(sizeof(To) == sizeof(From) &&
+                    std::is_trivially_copyable_v<To> &&
+                    std::is_trivially_copyable_v<From>,
+                "[-][mvm] invalid bit cast");
+  To to;
+  std::memcpy(&to, &from, sizeof(To));
+  return to;
+}
+
+template <std::size_t N> struct uint_of_size {};
+template <> struct uint_of_size<1> { using type = uint8_t; };
+template <> struct uint_of_size<2> { using type = uint16_t; };
+template <> struct uint_of_size<4> { using type = uint32_t; };
+template <> struct uint_of_size<8> { using type = uint64_t; };
+
+template <typename U> U byte_swap(U val) noexcept {
+  if constexpr (sizeof(U) == 1) {
+    return val;
   } else {
-    return 10;
+#if defined(__GNUC__) || defined(__clang__)
+    if constexpr (sizeof(U) == 2) {
+      return __builtin_bswap16(val);
+    } else if constexpr (sizeof(U) == 4) {
+      return __builtin_bswap32(val);
+    } else {
+      return __builtin_bswap64(val);
+    }
+#else
+    U res{0};
+    for (std::size_t i = 0; i < sizeof(U); ++i) {
+      res = static_cast<U>((res << 8) | ((val >> (i * 8)) & 0xFF));
+    }
+    return res;
+#endif
+  }
+}
+
+// T is stored on N bytes with its host representation, up to endianness
+template <typename T, std::size_t N>
+inline constexpr bool is_native_repr_v =
+    N == sizeof(T) && (N == 1 || N == 2 || N == 4 || N == 8) &&
+    (std::is_floating_point_v<T> ||
+     (std::is_integral_v<T> && !std::is_same_v<T, bool>));
+
+// integer token split in sign and magnitude
+struct integer_token {
+  bool negative{false};
+  uint64_t magnitude{0};
+};
+
+// [+-][0x]digits, nothing else
+inline std::optional<integer_token> parse_integer(std::string_view str) {
+  integer_token res;
+  if (!str.empty() && (str[0] == '-' || str[0] == '+')) {
+    res.negative = str[0] == '-';
+    str.remove_prefix(1);
   }
+
+  int base{10};
+  if (str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+    base = 16;
+    str.remove_prefix(2);
+  }
+
+  // from_chars accepts no sign after the one removed above
+  if (str.empty() || str[0] == '-') {
+    return std::nullopt;
+  }
+
+  auto last = str.data() + str.size();
+  auto [ptr, ec] = std::from_chars(str.data(), last, res.magnitude, base);
+  if (ec != std::errc{} || ptr != last) {
+    return std::nullopt;
+  }
+  return res;
+}
+
+// [-]decimal, scientific, inf or nan, the whole token is consumed
+template <typename T>
+bool parse_floating(std::string_view str, T &val) noexcept {
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  auto last = str.data() + str.size();
+  auto [ptr, ec] = std::from_chars(str.data(), last, val);
+  return ec == std::errc{} && ptr == last;
+#else
+  // no floating point from_chars, strtod on a nul terminated copy of the
+  // token, rejecting what from_chars would not accept
+  std::size_t first = !str.empty() && str[0] == '-';
+  if (str.size() <= first) {
+    return false;
+  }
+  auto c = static_cast<unsigned char>(str[first]);
+  if (!std::isdigit(c) && c != '.' && !std::isalpha(c)) {
+    return false;
+  }
+  if (str.size() > first + 1 && c == '0' &&
+      (str[first + 1] == 'x' || str[first + 1] == 'X')) {
+    return false;
+  }
+
+  char buf[128];
+  if (str.size() >= sizeof(buf)) {
+    return false;
+  }
+  std::memcpy(buf, str.data(), str.size());
+  buf[str.size()] = '\0';
+
+  char *end{nullptr};
+  errno = 0;
+  if constexpr (std::is_same_v<T, float>) {
+    val = std::strtof(buf, &end);
+  } else if constexpr (std::is_same_v<T, double>) {
+    val = std::strtod(buf, &end);
+  } else {
+    val = std::strtold(buf, &end);
+  }
+  return errno != ERANGE && end == buf + str.size();
+#endif
+}
+
+// max magnitude of a value of type T encoded on N bytes
+template <typename T, std::size_t N> constexpr uint64_t max_magnitude() {
+  constexpr std::size_t bits = std::is_signed_v<T> ? 8 * N - 1 : 8 * N;
+  constexpr uint64_t n_max =
+      bits >= 64 ? std::numeric_limits<uint64_t>::max()
+                 : (uint64_t{1} << (bits % 64)) - 1;
+  constexpr auto t_max = static_cast<uint64_t>(std::numeric_limits<T>::max());
+  return n_max < t_max ? n_max : t_max;
 }
 } // namespace details
 
 namespace traits {
 template <std::size_t N> struct ieee754_traits;
+} // namespace traits
+
+///
+/// @brief Parse a numeric token into a value of type T encoded on N bytes
+///
+/// Integers are decimal or hexadecimal with a 0x prefix. Floating point
+/// values are decimal or scientific, nan and inf included. The whole token
+/// must be consumed and the value must fit in both T and N bytes.
+///
+/// @return the value or nullopt, the parsing never allocates
+///
+template <typename T, std::size_t N>
+std::optional<T> parse_number(std::string_view str) noexcept {
+  if constexpr (std::is_floating_point_v<T>) {
+    // from_chars only accepts a minus sign
+    if (!str.empty() && str[0] == '+') {
+      str.remove_prefix(1);
+      if (str.empty() || str[0] == '-') {
+        return std::nullopt;
+      }
+    }
+
+    T val{};
+    if (!details::parse_floating(str, val)) {
+      return std::nullopt;
+    }
 
+    // finite values must stay finite in the N bytes format
+    using floating_type = typename traits::ieee754_traits<N>::floating_type;
+    constexpr auto max = std::numeric_limits<floating_type>::max();
+    auto magnitude = val < 0 ? -val : val;
+    if (magnitude > max && magnitude != std::numeric_limits<T>::infinity()) {
+      return std::nullopt;
+    }
+    return val;
+  } else {
+    static_assert(std::is_integral_v<T> && N <= 8,
+                  "[-][mvm] unsupported numeric operand");
+
+    auto token = details::parse_integer(str);
+    if (!token) {
+      return std::nullopt;
+    }
+
+    constexpr auto max = details::max_magnitude<T, N>();
+    if constexpr (std::is_unsigned_v<T>) {
+      if ((token->negative && token->magnitude != 0) ||
+          token->magnitude > max) {
+        return std::nullopt;
+      }
+      return static_cast<T>(token->magnitude);
+    } else {
+      // two's complement holds one more negative value
+      if (token->magnitude > max + token->negative) {
+        return std::nullopt;
+      }
+      // unsigned negation then narrowing is two's complement
+      return static_cast<T>(token->negative ? 0 - token->magnitude
+                                            : token->magnitude);
+    }
+  }
+}
+
+namespace traits {
 template <> struct ieee754_traits<4> {
   using unsigned_type = uint32_t;
+  using floating_type = float;
   static constexpr std::size_t sign_size = 1;
   static constexpr std::size_t exp_size = 8;
   static constexpr std::size_t mant_size = 23;
@@ -73,6 +275,7 @@ template <> struct ieee754_traits<4> {
 
 template <> struct ieee754_traits<8> {
   using unsigned_type = uint64_t;
+  using floating_type = double;
   static constexpr std::size_t sign_size = 1;
   static constexpr std::size_t exp_size = 11;
   static constexpr std::size_t mant_size = 52;
@@ -80,6 +283,11 @@ template <> struct ieee754_traits<8> {
   static constexpr int32_t exp_mask = 0x7FF;
   static constexpr unsigned_type mant_mask = 0xFFFFFFFFFFFFF;
 };
+
+static_assert(std::numeric_limits<float>::is_iec559 &&
+                  std::numeric_limits<double>::is_iec559 &&
+                  sizeof(float) == 4 && sizeof(double) == 8,
+              "[-][mvm] float and double must be IEEE754 binary32/64");
 } // namespace traits
 
 template <typename T, typename Array, size_t... Is>
@@ -114,78 +322,35 @@ T parse_signed(std::array<uint8_t, N> const &bytes) {
 }
 
 template <typename T, std::size_t N> auto serial_signed(int64_t val) {
-  T tval = static_cast<T>(val);
-
-  if (tval >= 0) {
-    return serial_unsigned<N>(tval);
-  } else {
-    using unsigned_type = std::make_unsigned_t<T>;
-    unsigned_type uval = std::abs(tval);
-    uval = ~uval + 1;
-
-    return serial_unsigned<N>(uval);
-  }
+  // conversion to unsigned is modulo 2^n, that is two's complement
+  return serial_unsigned<N>(
+      static_cast<std::make_unsigned_t<T>>(static_cast<T>(val)));
 }
 
+// IEEE754 values are stored with the representation of their N bytes
+// format, whatever the host floating point type T
 template <typename T, std::size_t N>
 T parse_floating(std::array<uint8_t, N> const &bytes) {
-  if constexpr (N == 4 || N == 8) {
-    using ieee754_type = traits::ieee754_traits<N>;
-    using unsigned_type = typename ieee754_type::unsigned_type;
+  using ieee754_type = traits::ieee754_traits<N>;
+  using unsigned_type = typename ieee754_type::unsigned_type;
+  using floating_type = typename ieee754_type::floating_type;
 
-    auto f_as_ui = parse_unsigned<unsigned_type>(bytes);
-    uint16_t exp =
-        (f_as_ui >> ieee754_type::mant_size) & ieee754_type::exp_mask;
-    unsigned_type mant =
-        (f_as_ui & ieee754_type::mant_mask) + (1ULL << ieee754_type::mant_size);
-    bool neg =
-        (f_as_ui >> (ieee754_type::mant_size + ieee754_type::exp_size)) & 0x1;
-
-    T output = static_cast<T>(std::ldexp(mant, static_cast<int32_t>(exp) -
-                                                   ieee754_type::exp_shift -
-                                                   ieee754_type::mant_size));
-
-    if (neg) {
-      output = -output;
-    }
-
-    return output;
-  }
+  return static_cast<T>(details::bit_cast<floating_type>(
+      parse_unsigned<unsigned_type>(bytes)));
 }
 
-template <typename T, std::size_t N> auto serial_floating(double val) {
-  T tval = static_cast<T>(val);
+template <typename T, std::size_t N> auto serial_floating(T val) {
+  using ieee754_type = traits::ieee754_traits<N>;
+  using unsigned_type = typename ieee754_type::unsigned_type;
+  using floating_type = typename ieee754_type::floating_type;
 
-  if constexpr (N == 4 || N == 8) {
-    using ieee754_type = traits::ieee754_traits<N>;
-    using unsigned_type = typename ieee754_type::unsigned_type;
-
-    int32_t exp;
-    auto d_mant = std::frexp(tval, &exp);
-
-    // exp to store
-    exp = exp - 1 + ieee754_type::exp_shift; // -1 because the radix point is
-                                             // shifted in frexp
-
-    unsigned_type neg = std::signbit(tval);
-    d_mant = fabs(d_mant) * 2 - 1; // again the shift is the radix point
-
-    unsigned_type u_exp = exp;
-    unsigned_type u_mant =
-        static_cast<unsigned_type>(std::ldexp(d_mant, ieee754_type::mant_size));
-
-    unsigned_type u_bytes;
-    u_bytes = (u_mant & ieee754_type::mant_mask);
-    u_bytes |= ((u_exp & ieee754_type::exp_mask) << ieee754_type::mant_size);
-    u_bytes |=
-        ((neg & 0x1) << (ieee754_type::mant_size + ieee754_type::exp_size));
-
-    return serial_unsigned<N>(u_bytes);
-  }
+  return serial_unsigned<N>(details::bit_cast<unsigned_type>(
+      static_cast<floating_type>(val)));
 }
 
+// byte by byte decode, any T and N
 template <typename T, std::size_t N, typename Endian>
-auto parse(uint8_t const *bytes) {
+auto parse_portable(uint8_t const *bytes) {
   auto bytes_arr = details::to_endian<N, Endian, little_endian_tag>()(bytes);
 
   if constexpr (std::is_floating_point_v<T>) {
@@ -198,16 +363,82 @@ auto parse(uint8_t const *bytes) {
 }
 
 template <typename T, std::size_t N, typename Endian>
-std::array<uint8_t, N> serial(std::string const &str) {
-  std::array<uint8_t, N> res;
+auto parse(uint8_t const *bytes) {
+  if constexpr (details::is_native_repr_v<T, N>) {
+    // single unaligned load, swapped if endianness differs from the host
+    using unsigned_type = typename details::uint_of_size<N>::type;
+    unsigned_type val;
+    std::memcpy(&val, bytes, N);
+    if constexpr (!std::is_same_v<Endian, native_endian_tag>) {
+      val = details::byte_swap(val);
+    }
+    return details::bit_cast<T>(val);
+  } else {
+    return parse_portable<T, N, Endian>(bytes);
+  }
+}
+
+///
+/// @brief Serialize a value to its N bytes, in Endian order
+///
+/// @return iterator past the last written byte
+///
+template <typename T, std::size_t N, typename Endian, typename OutputIt>
+OutputIt serial_into(T val, OutputIt out) {
+  static_assert(N <= sizeof(uint64_t), "[-][mvm] unsupported operand size");
+
+  uint64_t bits;
   if constexpr (std::is_floating_point_v<T>) {
-    res = serial_floating<T, N>(std::stod(str));
-  } else if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>) {
-    res = serial_unsigned<N>(std::stoull(str, nullptr, details::base(str)));
-  } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
-    res = serial_signed<T, N>(std::stoll(str, nullptr, details::base(str)));
+    using ieee754_type = traits::ieee754_traits<N>;
+    using unsigned_type = typename ieee754_type::unsigned_type;
+    using floating_type = typename ieee754_type::floating_type;
+    bits = details::bit_cast<unsigned_type>(static_cast<floating_type>(val));
+  } else {
+    // conversion to unsigned is modulo 2^n, that is two's complement
+    bits = static_cast<std::make_unsigned_t<T>>(val);
   }
 
-  return details::to_endian<N, little_endian_tag, Endian>()(&res[0]);
+  for (std::size_t i = 0; i < N; ++i) {
+    auto shift = std::is_same_v<Endian, big_endian_tag> ? N - 1 - i : i;
+    *out = static_cast<uint8_t>(bits >> (shift * 8) & 0xFF);
+    ++out;
+  }
+  return out;
+}
+
+template <typename T, std::size_t N, typename Endian>
+std::array<uint8_t, N> serial_value(T val) {
+  std::array<uint8_t, N> res;
+  serial_into<T, N, Endian>(val, res.begin());
+  return res;
+}
+
+///
+/// @brief Serialize a numeric token
+///
+/// @throw std::invalid_argument if parse_number rejects the token
+///
+template <typename T, std::size_t N, typename Endian>
+std::array<uint8_t, N> serial(std::string_view str) {
+  auto val = parse_number<T, N>(str);
+  if (!val) {
+    throw std::invalid_argument("[-][mvm] invalid numeric token");
+  }
+  return serial_value<T, N, Endian>(*val);
+}
+
+///
+/// @brief Serialize a numeric token in place
+///
+/// @return iterator past the last written byte
+/// @throw std::invalid_argument if parse_number rejects the token
+///
+template <typename T, std::size_t N, typename Endian, typename OutputIt>
+OutputIt serial_into(std::string_view str, OutputIt out) {
+  auto val = parse_number<T, N>(str);
+  if (!val) {
+    throw std::invalid_argument("[-][mvm] invalid numeric token");
+  }
+  return serial_into<T, N, Endian>(*val, out);
 }
 } // namespace mvm::num
\ No newline at end of file
@@ -93,4 +93,15 @@ inline constexpr auto has_push = is_valid(
 
 inline constexpr auto has_pop = is_valid(
     [](auto x, auto &&... args) -> decltype((void)value_t(x).pop(args...)) {});
+
+inline constexpr auto has_reserve = is_valid(
+    [](auto x, auto &&... args) -> decltype((void)value_t(x).reserve(args...)) {
+    });
+
+inline constexpr auto has_replace = is_valid(
+    [](auto x, auto &&... args) -> decltype((void)value_t(x).replace(args...)) {
+    });
+
+inline constexpr auto has_high_water_mark =
+    is_valid([](auto x) -> decltype((void)value_t(x).high_water_mark()) {});
 } // namespace mvm::reflect
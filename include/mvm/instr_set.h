@@ -14,8 +14,13 @@
 
 #pragma once
 
+#include "mvm/helpers/reflect.h"
 #include "mvm/meta.h"
 
+#include <array>
+#include <type_traits>
+#include <utility>
+
 namespace mvm {
 
 template <typename... Ts> using instr_set_desc = list::mplist<Ts...>;
@@ -30,17 +35,27 @@ template <typename Set> struct instr_set {
 private:
   using instr_set_type = Set;
 
+  // handlers may be members of a base of the vm set, GCC reports strict
+  // aliasing issues when they are called on the derived object
+  template <auto Func, typename VM, typename... Args>
+  static auto call_handler(VM &vm, Args &&... args) {
+    Set &set = vm;
+    return (set.*Func)(std::forward<Args>(args)...);
+  }
+
   template <bool DoUpdateIp, typename Consumers, typename Producers, typename S>
   struct base_instr {
     // all the following static types and values are just shortcuts
     // for easy access to instructions props
     using name_type = S;
     using value_stack_type = value_stack_types_t<Producers>;
-    using bytecode_type = bytecode_types_t<Consumers>;
+    using bytecode_type = instr_bytecode_types_t<Producers, Consumers>;
     using consumers_type = Consumers;
     using producers_type = Producers;
 
     static constexpr bool doUpdateIp = DoUpdateIp;
+    static constexpr bool isPipe = false;
+    static constexpr bool isInPlace = false;
   };
 
   template <typename Consumers, typename Producers, bool DoUpdateIp,
@@ -50,11 +65,21 @@ private:
   struct generic_instr : base_instr<DoUpdateIp, Consumers, Producers, S> {
     template <typename VM, typename... Args>
     static auto apply(VM &vm, Args &&... args) {
-      return (vm.*Func)(std::forward<Args>(args)...);
+      return call_handler<Func>(vm, std::forward<Args>(args)...);
     }
   };
 
 public:
+  // the handler returns the values of all producers in a single tuple
+  template <typename Consumers, typename Producers, bool DoUpdateIp,
+            auto Func, typename S>
+  struct consumers_producers_instr
+      : generic_instr<Consumers, Producers, DoUpdateIp, Func, S> {};
+
+  template <typename Producers, bool DoUpdateIp, auto Func, typename S>
+  struct producers_instr
+      : generic_instr<no_cons, Producers, DoUpdateIp, Func, S> {};
+
   template <typename Consumers, typename Producer, bool DoUpdateIp, auto Func,
             typename S>
   struct consumers_producer_instr
@@ -81,13 +106,44 @@ public:
   template <typename Consumer, typename Producer, typename S>
   struct consumer_producer_pipe
       : base_instr<false, consumers<Consumer>, producers<Producer>, S> {
+    static constexpr bool isPipe = true;
+
     template <typename VM, typename Arg> static auto apply(VM &vm, Arg arg) {
       return arg;
     }
   };
 
+  // the handler reads its operands by reference in the top value stack slots,
+  // deepest first, and its result replaces them
+  template <typename Consumer, typename Producer,
+            typename details::desc_to_ref_proto<Set, producers<Producer>,
+                                                consumers<Consumer>>::type Func,
+            typename S>
+  struct in_place_instr
+      : base_instr<false, consumers<Consumer>, producers<Producer>, S> {
+    static_assert(
+        reflect::is_same_meta_v<Consumer::template meta_type,
+                                meta_value_stack> &&
+            reflect::is_same_meta_v<Producer::template meta_type,
+                                    meta_value_stack>,
+        "[-][mvm] in place instructions only work on the value stack");
+    static_assert(!list::is_empty_v<typename Consumer::meta_data_type> &&
+                      list::size_v<typename Producer::meta_data_type> == 1,
+                  "[-][mvm] in place instructions replace at least one "
+                  "value by a single one");
+
+    static constexpr bool isInPlace = true;
+
+    template <typename VM, typename... Args>
+    static auto apply(VM &vm, Args &&... args) {
+      return call_handler<Func>(vm, std::forward<Args>(args)...);
+    }
+  };
+
   template <typename Consumer, typename S>
   struct consumer_pipe : base_instr<false, consumers<Consumer>, no_prod, S> {
+    static constexpr bool isPipe = true;
+
     template <typename VM, typename Arg> static void apply(VM &vm, Arg arg) {
       // sink
     }
@@ -114,31 +170,32 @@ public:
 /// @brief Instruction set visitor used to call the right instruction callback
 ///  according to the instruction index.
 ///
-/// @warning For small instruction set, the performance is ok, but macro
-/// unrolling
-///          is better when the set size increases.
+/// Dispatch goes through a constexpr table of thunks, one per instruction,
+/// generated for each callable type.
 ///
-template <typename TList, size_t N = list::size_v<TList> - 1>
-struct instr_set_visitor {
+template <typename TList> struct instr_set_visitor {
   template <typename Callable> void operator()(size_t n, Callable &&c) const {
-    if (N == n) {
-      using instr_type = list::at_t<N, TList>;
-      std::forward<Callable>(c)(instr_type{});
-    } else {
-      instr_set_visitor<TList, N - 1>()(n, std::forward<Callable>(c));
-    }
-  }
-};
+    using callable_type = std::remove_reference_t<Callable>;
+    static constexpr auto table = make_table<callable_type>(
+        std::make_index_sequence<list::size_v<TList>>());
 
-template <typename TList> struct instr_set_visitor<TList, 0> {
-  template <typename Callable> void operator()(size_t n, Callable &&c) const {
-    if (n == 0) {
-      using instr_type = list::at_t<0, TList>;
-      std::forward<Callable>(c)(instr_type{});
-    } else {
-      throw mexcept("[-][mvm] instruction opcode overflow",
+    if (MVM_UNLIKELY(n >= table.size())) {
+      throw_mexcept("[-][mvm] instruction opcode overflow",
                     status_type::INVALID_INSTR_OPCODE);
     }
+    table[n](c);
+  }
+
+private:
+  template <typename Callable, size_t N> static void thunk(Callable &c) {
+    using instr_type = list::at_t<N, TList>;
+    c(instr_type{});
+  }
+
+  template <typename Callable, size_t... Ns>
+  static constexpr auto make_table(std::index_sequence<Ns...>) {
+    return std::array<void (*)(Callable &), sizeof...(Ns)>{
+        &instr_set_visitor::thunk<Callable, Ns>...};
   }
 };
 } // namespace mvm
\ No newline at end of file
@@ -19,11 +19,17 @@
 #include "mvm/instr_set.h"
 #include "mvm/macros.h"
 #include "mvm/meta.h"
+#include "mvm/opcode_profile.h"
+#include "mvm/profiled_stack.h"
 #include "mvm/program.h"
 #include "mvm/trace.h"
 #include "mvm/traits.h"
 
+#include <array>
+#include <cstddef>
+#include <memory_resource>
 #include <tuple>
+#include <type_traits>
 
 namespace mvm {
 
@@ -47,20 +53,128 @@ template <typename Set, typename InstanceList> class interpreter {
   rebasable_ip m_rebased_ip;
 
 public:
+  using stack_profile_type = stack_profile<list::size_v<instance_list_type>>;
+  using opcode_profile_type =
+      opcode_profile<instr_set_traits_type::instr_set_size>;
+
   explicit interpreter(instr_set_type &iset) : m_iset{iset} {}
 
+  ///
+  /// @brief Build interpreter with instances allocating from a memory resource
+  ///
+  /// @note only instances constructible from a memory resource use it
+  ///
+  interpreter(instr_set_type &iset, std::pmr::memory_resource *res)
+      : m_iset{iset}, m_instances{make_instances(
+                          static_cast<instances_container_type *>(nullptr),
+                          res)} {}
+
   ///
   /// @brief Interpret code chunk
   ///
-  void interpret(prog_chunk const &c);
+  template <typename Alloc> void interpret(basic_prog_chunk<Alloc> const &c);
+
+  ///
+  /// @brief Interpret code chunk with profiled stacks sized from a previous
+  /// run profile
+  ///
+  /// The profile is updated with the max depth reached by each stack.
+  ///
+  template <typename Alloc>
+  void interpret(basic_prog_chunk<Alloc> const &c, stack_profile_type &profile);
+
+  ///
+  /// @brief Interpret code chunk and count executions of each instruction
+  ///
+  /// Counts are added to the profile, see write_opcode_profile to feed
+  /// them back to the build.
+  ///
+  template <typename Alloc>
+  void interpret(basic_prog_chunk<Alloc> const &c,
+                 opcode_profile_type &profile);
 
 private:
-  // run interpreter loop
-  void run();
+  // size profiled stacks before a run
+  template <std::size_t... Is>
+  void prepare_stacks(stack_profile_type const &profile,
+                      std::index_sequence<Is...>);
+
+  // record profiled stacks usage after a run
+  template <std::size_t... Is>
+  void record_stacks(stack_profile_type &profile, std::index_sequence<Is...>);
+
+  // build all instances with a memory resource
+  template <typename... Is>
+  static std::tuple<Is...> make_instances(std::tuple<Is...> *,
+                                          std::pmr::memory_resource *res) {
+    return std::tuple<Is...>{make_instance<Is>(res)...};
+  }
+
+  template <typename IS>
+  static IS make_instance(std::pmr::memory_resource *res) {
+    if constexpr (std::is_constructible_v<IS, std::pmr::memory_resource *>) {
+      return IS(res);
+    } else {
+      return IS{};
+    }
+  }
+
+  // run interpreter loop, calling a hook before each instruction
+  template <typename Hook> void run(Hook &&hook);
+
+  // count the instruction at ip
+  void count_instr(opcode_profile_type &profile);
+
+  // interpret instruction from the hot or the cold section
+  template <typename I> void handle_instr() {
+    if constexpr (instr_set_traits_type::template is_hot_instr<I>) {
+      this->interpret_instr<I>();
+    } else {
+      this->interpret_cold<I>();
+    }
+  }
 
   // interpret single instruction
   template <typename I> void interpret_instr();
 
+  // pipe moving a single value between bytecode and value stacks
+  template <typename I> static constexpr bool is_direct_pipe() {
+    if constexpr (!concept ::is_pipe_v<I>) {
+      return false;
+    } else {
+      using consumer_type = list::front_t<typename I::consumers_type>;
+      constexpr bool plain_consumer =
+          !concept ::is_iterable_consumer_v<consumer_type> &&
+          !concept ::is_meta_register_file_v<consumer_type::template meta_type>;
+
+      if constexpr (concept ::is_producer_v<I>) {
+        using producer_type =
+            typename traits::producers_traits<I>::producer_type;
+        return plain_consumer && !concept ::is_meta_register_file_v<
+                                     producer_type::template meta_type>;
+      } else {
+        return plain_consumer;
+      }
+    }
+  }
+
+  // interpret pipe without handler call nor argument forwarding
+  template <typename I> void interpret_pipe();
+
+  // interpret instruction reading and replacing the top stack slots
+  template <typename I> void interpret_in_place();
+
+  template <typename I, typename IS, std::size_t... Is>
+  void replace_in_place(IS &stack, std::index_sequence<Is...>);
+
+  // interpret single instruction out of the hot code
+  template <typename I> MVM_COLD void interpret_cold() {
+    this->interpret_instr<I>();
+  }
+
+  // interpret instruction with a two byte opcode
+  void interpret_extended();
+
   // produce data to producer instance
   template <typename IS, typename V, typename T> void produce(T &&arg);
 
@@ -117,6 +231,22 @@ private:
       return consume_one<I, Consumers, Consumer, list::pop_front_t<DataList>>(
           this->consume_bytecode<instance_type, list::front_t<DataList>>(),
           std::forward<Args>(args)...);
+    } else if constexpr (concept ::is_meta_register_file_v<
+                             Consumer::template meta_type>) {
+      // register read, index from the bytecode or fixed
+      using reg_type = list::front_t<DataList>;
+      auto &regs = std::get<instance_type>(m_instances);
+      if constexpr (concept ::is_code_reg_v<reg_type>) {
+        return consume_one<I, Consumers, Consumer, list::pop_front_t<DataList>>(
+            typename reg_type::value_type{
+                regs.get(this->consume_register_index<reg_type>())},
+            std::forward<Args>(args)...);
+      } else {
+        return consume_one<I, Consumers, Consumer, list::pop_front_t<DataList>>(
+            typename reg_type::value_type{
+                regs.template get<reg_type::index>()},
+            std::forward<Args>(args)...);
+      }
     } else if constexpr (concept ::is_iterable_consumer_v<Consumer>) {
       using counter_type = typename Consumer::counter_type;
       auto code = this->consume_bytecode<
@@ -144,13 +274,68 @@ private:
     }
   }
 
+  // read a register index from the bytecode
+  template <typename R> std::size_t consume_register_index() {
+    return static_cast<std::size_t>(
+        this->consume_bytecode<instance_of_t<instance_list_type, meta_bytecode>,
+                               typename R::index_type>());
+  }
+
+  // read register indexes of a producer, fixed ones included
+  template <typename... Rs>
+  std::array<std::size_t, sizeof...(Rs)>
+  consume_register_indexes(list::mplist<Rs...>) {
+    // braced init list guarantees left to right bytecode parsing
+    return {this->register_index<Rs>()...};
+  }
+
+  template <typename R> std::size_t register_index() {
+    if constexpr (concept ::is_code_reg_v<R>) {
+      return this->consume_register_index<R>();
+    } else {
+      return R::index;
+    }
+  }
+
+  // produce data to register file instance
+  template <typename IS, typename DataList, typename T, std::size_t... Is>
+  void produce_registers(std::array<std::size_t, sizeof...(Is)> const &dest,
+                         T &&arg, std::index_sequence<Is...>);
+
+  // write single register
+  template <typename IS, typename R, typename T>
+  void write_register(std::size_t index, T &&arg);
+
+  // read destination register indexes of a producer, none for stacks
+  template <typename P> auto producer_dest() {
+    if constexpr (concept ::is_meta_register_file_v<P::template meta_type>) {
+      return this->consume_register_indexes(typename P::meta_data_type{});
+    } else {
+      return std::array<std::size_t, 0>{};
+    }
+  }
+
+  template <typename... Ps> auto producer_dests(producers<Ps...>) {
+    // braced init list guarantees left to right bytecode parsing
+    return std::tuple{this->producer_dest<Ps>()...};
+  }
+
+  // route the result of a multiple producer instruction to its producers
+  template <typename I, typename Dests, typename T, std::size_t... Ps>
+  void produce_all(Dests const &dests, T &&res, std::index_sequence<Ps...>);
+
+  // produce the values of a single producer from the whole result
+  template <typename P, std::size_t Offset, typename Dest, typename T,
+            std::size_t... Is>
+  void produce_part(Dest const &dest, T &res, std::index_sequence<Is...>);
+
   // parse bytecode
   template <typename IS, typename DataType> auto consume_bytecode() {
     uint8_t *ip = m_rebased_ip;
     m_rebased_ip += instr_set_traits_type::template type_size<DataType>;
 
-    if (!m_rebased_ip.assert_in_chunk()) {
-      throw mexcept("[-][mvm] bytecode overflow", status_type::CODE_OVERFLOW);
+    if (MVM_UNLIKELY(!m_rebased_ip.assert_in_chunk())) {
+      throw_mexcept("[-][mvm] bytecode overflow", status_type::CODE_OVERFLOW);
     }
 
     return std::get<IS>(m_instances)
@@ -177,60 +362,310 @@ private:
 
 // impl
 template <typename Set, typename InstancesList>
-void interpreter<Set, InstancesList>::interpret(prog_chunk const &chunk) {
+template <typename Alloc>
+void interpreter<Set, InstancesList>::interpret(
+    basic_prog_chunk<Alloc> const &chunk) {
+  m_rebased_ip.rebase(&(chunk.code[0]),
+                      &(chunk.code[0]) + chunk.code.size() - 1);
+
+  this->run([]() {});
+}
+
+template <typename Set, typename InstancesList>
+template <typename Alloc>
+void interpreter<Set, InstancesList>::interpret(
+    basic_prog_chunk<Alloc> const &chunk, opcode_profile_type &profile) {
   m_rebased_ip.rebase(&(chunk.code[0]),
                       &(chunk.code[0]) + chunk.code.size() - 1);
 
-  this->run();
+  this->run([this, &profile]() { this->count_instr(profile); });
 }
 
 template <typename Set, typename InstancesList>
-void interpreter<Set, InstancesList>::run() {
+template <typename Alloc>
+void interpreter<Set, InstancesList>::interpret(
+    basic_prog_chunk<Alloc> const &chunk, stack_profile_type &profile) {
+  using indexes_type =
+      std::make_index_sequence<list::size_v<instance_list_type>>;
+
+  this->prepare_stacks(profile, indexes_type{});
+  try {
+    this->interpret(chunk);
+  } catch (...) {
+    this->record_stacks(profile, indexes_type{});
+    throw;
+  }
+  this->record_stacks(profile, indexes_type{});
+}
+
+template <typename Set, typename InstancesList>
+template <std::size_t... Is>
+void interpreter<Set, InstancesList>::prepare_stacks(
+    stack_profile_type const &profile, std::index_sequence<Is...>) {
+  auto prepare = [&profile](auto &instance, std::size_t depth) {
+    if constexpr (concept ::is_profiled_stack_v<
+                      std::decay_t<decltype(instance)>>) {
+      instance.prepare(depth, profile.fixed_capacity);
+    }
+  };
+  (prepare(std::get<Is>(m_instances), profile.high_water[Is]), ...);
+}
+
+template <typename Set, typename InstancesList>
+template <std::size_t... Is>
+void interpreter<Set, InstancesList>::record_stacks(
+    stack_profile_type &profile, std::index_sequence<Is...>) {
+  auto record = [&profile](auto const &instance, std::size_t &depth) {
+    if constexpr (concept ::is_profiled_stack_v<
+                      std::decay_t<decltype(instance)>>) {
+      if (instance.high_water_mark() > depth) {
+        depth = instance.high_water_mark();
+        profile.grown = true;
+      }
+    }
+  };
+  (record(std::get<Is>(m_instances), profile.high_water[Is]), ...);
+}
+
+template <typename Set, typename InstancesList>
+void interpreter<Set, InstancesList>::count_instr(
+    opcode_profile_type &profile) {
+  std::size_t index = *m_rebased_ip;
+  if (instr_set_traits_type::is_extended &&
+      index == instr_set_traits_type::opcode_escape) {
+    // overflow is reported by the dispatch
+    ++m_rebased_ip;
+    auto in_chunk = m_rebased_ip.assert_in_chunk();
+    index = in_chunk ? instr_set_traits_type::short_opcode_count + *m_rebased_ip
+                     : profile.counts.size();
+    m_rebased_ip -= 1;
+  }
+
+  if (index < profile.counts.size()) {
+    ++profile.counts[index];
+  }
+}
+
+template <typename Set, typename InstancesList>
+template <typename Hook>
+void interpreter<Set, InstancesList>::run(Hook &&hook) {
   while (m_rebased_ip.assert_in_chunk()) {
     LOG_INFO("interpreter -> process instruction opcode "
              << static_cast<int>(*m_rebased_ip));
+    hook();
 
 #ifdef FASTI
 #define MVM_INTERPRETER_I(n)                                                   \
   case n: {                                                                    \
     using instr_type = list::at_t<n, instr_set_desc_type>;                     \
-    if constexpr (!std::is_same_v<instr_type, nonsuch>) {                      \
-      this->interpret_instr<instr_type>();                                     \
+    if constexpr (instr_set_traits_type::is_extended &&                        \
+                  n == instr_set_traits_type::opcode_escape) {                 \
+      this->interpret_extended();                                              \
+    } else if constexpr (!std::is_same_v<instr_type, nonsuch>) {               \
+      this->handle_instr<instr_type>();                                        \
     } else {                                                                   \
-      throw mexcept("[-][mvm] invalid instruction opcode",                     \
+      throw_mexcept("[-][mvm] invalid instruction opcode",                     \
                     status_type::INVALID_INSTR_OPCODE);                        \
     }                                                                          \
   } break;
     switch (*m_rebased_ip) {
       MVM_UNROLL_256(MVM_INTERPRETER_I)
     default:
-      throw mexcept("[-][mvm] instruction opcode overflow",
+      throw_mexcept("[-][mvm] instruction opcode overflow",
                     status_type::INSTR_OPCODE_OVERFLOW);
     }
 #else
+    if constexpr (instr_set_traits_type::is_extended) {
+      if (*m_rebased_ip == instr_set_traits_type::opcode_escape) {
+        this->interpret_extended();
+        continue;
+      }
+    }
     instr_set_visitor<instr_set_desc_type>()(*m_rebased_ip, [this](auto &&arg) {
       using instr_type = std::decay_t<decltype(arg)>;
       LOG_INFO("interpreter -> process instruction "
                << typestring::char_seq<typename instr_type::name_type>::value);
-      this->interpret_instr<instr_type>();
+      this->handle_instr<instr_type>();
     });
 #endif
   }
 }
 
+template <typename Set, typename InstancesList>
+void interpreter<Set, InstancesList>::interpret_extended() {
+  ++m_rebased_ip;
+  if (MVM_UNLIKELY(!m_rebased_ip.assert_in_chunk())) {
+    throw_mexcept("[-][mvm] bytecode overflow", status_type::CODE_OVERFLOW);
+  }
+
+  // second level dispatch, ip stays on the last opcode byte
+  instr_set_visitor<instr_set_desc_type>()(
+      instr_set_traits_type::short_opcode_count + *m_rebased_ip,
+      [this](auto &&arg) {
+        using instr_type = std::decay_t<decltype(arg)>;
+        LOG_INFO("interpreter -> process instruction "
+                 << typestring::char_seq<
+                        typename instr_type::name_type>::value);
+        this->handle_instr<instr_type>();
+      });
+}
+
 template <typename Set, typename InstancesList>
 template <typename I>
 void interpreter<Set, InstancesList>::interpret_instr() {
-  if constexpr (concept ::is_producer_v<I>) {
-    this->produce<
-        instance_of_tie_t<instance_list_type,
-                          typename traits::producers_traits<I>::producer_type>,
-        typename traits::producers_traits<I>::data_type>(this->consume<I>());
+  if constexpr (is_direct_pipe<I>()) {
+    this->interpret_pipe<I>();
+  } else if constexpr (concept ::is_in_place_v<I>) {
+    this->interpret_in_place<I>();
+  } else if constexpr (list::size_v<typename I::producers_type> > 1) {
+    using producers_type = typename I::producers_type;
+    using indexes_type =
+        std::make_index_sequence<list::size_v<producers_type>>;
+    // destination registers are read from the bytecode first
+    auto dests = this->producer_dests(producers_type{});
+    this->produce_all<I>(dests, this->consume<I>(), indexes_type{});
+  } else if constexpr (concept ::is_producer_v<I>) {
+    using producer_type = typename traits::producers_traits<I>::producer_type;
+    using instance_type = instance_of_tie_t<instance_list_type, producer_type>;
+
+    if constexpr (concept ::is_meta_register_file_v<
+                      producer_type::template meta_type>) {
+      // destination registers are read from the bytecode first
+      using datalist_type = typename producer_type::meta_data_type;
+      auto dest = this->consume_register_indexes(datalist_type{});
+      this->produce_registers<instance_type, datalist_type>(
+          dest, this->consume<I>(),
+          std::make_index_sequence<list::size_v<datalist_type>>());
+    } else {
+      this->produce<instance_type,
+                    typename traits::producers_traits<I>::data_type>(
+          this->consume<I>());
+    }
   } else {
     this->consume<I>();
   }
 }
 
+template <typename Set, typename InstancesList>
+template <typename I>
+void interpreter<Set, InstancesList>::interpret_pipe() {
+  using consumer_type = list::front_t<typename I::consumers_type>;
+  using consumer_instance_type =
+      instance_of_tie_t<instance_list_type, consumer_type>;
+  using data_type = list::front_t<typename consumer_type::meta_data_type>;
+
+  auto val = [this]() {
+    if constexpr (concept ::is_meta_bytecode_v<
+                      consumer_type::template meta_type>) {
+      return this->consume_bytecode<consumer_instance_type, data_type>();
+    } else {
+      return std::get<consumer_instance_type>(m_instances)
+          .template pop<data_type>();
+    }
+  }();
+  ++m_rebased_ip;
+
+  if constexpr (concept ::is_producer_v<I>) {
+    using producer_type = typename traits::producers_traits<I>::producer_type;
+    this->produce<instance_of_tie_t<instance_list_type, producer_type>,
+                  typename traits::producers_traits<I>::data_type>(
+        std::move(val));
+  }
+}
+
+template <typename Set, typename InstancesList>
+template <typename I>
+void interpreter<Set, InstancesList>::interpret_in_place() {
+  using consumer_type = list::front_t<typename I::consumers_type>;
+  using instance_type = instance_of_tie_t<instance_list_type, consumer_type>;
+  using datalist_type = typename consumer_type::meta_data_type;
+
+  if constexpr (concept ::is_in_place_stack_v<instance_type>) {
+    this->replace_in_place<I>(
+        std::get<instance_type>(m_instances),
+        std::make_index_sequence<list::size_v<datalist_type>>());
+  } else {
+    // stack without slot access, fallback to pop and push
+    this->produce<instance_type,
+                  typename traits::producers_traits<I>::data_type>(
+        this->consume<I>());
+  }
+}
+
+template <typename Set, typename InstancesList>
+template <typename I, typename IS, std::size_t... Is>
+void interpreter<Set, InstancesList>::replace_in_place(
+    IS &stack, std::index_sequence<Is...>) {
+  using datalist_type =
+      typename list::front_t<typename I::consumers_type>::meta_data_type;
+  constexpr std::size_t count = sizeof...(Is);
+
+  // operands are given deepest first, as if they were popped
+  auto res = this->apply<I>(
+      stack.template peek<list::at_t<Is, datalist_type>>(count - 1 - Is)...);
+  stack.replace(count, std::move(res));
+}
+
+template <typename Set, typename InstancesList>
+template <typename I, typename Dests, typename T, std::size_t... Ps>
+void interpreter<Set, InstancesList>::produce_all(Dests const &dests, T &&res,
+                                                  std::index_sequence<Ps...>) {
+  using traits_type = traits::producers_traits<I>;
+  using producers_type = typename traits_type::producers_type;
+
+  (this->produce_part<list::at_t<Ps, producers_type>,
+                      traits_type::template result_offset<Ps>()>(
+       std::get<Ps>(dests), res,
+       std::make_index_sequence<list::size_v<
+           typename list::at_t<Ps, producers_type>::meta_data_type>>()),
+   ...);
+}
+
+template <typename Set, typename InstancesList>
+template <typename P, std::size_t Offset, typename Dest, typename T,
+          std::size_t... Is>
+void interpreter<Set, InstancesList>::produce_part(Dest const &dest, T &res,
+                                                   std::index_sequence<Is...>) {
+  using instance_type = instance_of_tie_t<instance_list_type, P>;
+  using datalist_type = typename P::meta_data_type;
+
+  if constexpr (concept ::is_meta_register_file_v<P::template meta_type>) {
+    (this->write_register<instance_type, list::at_t<Is, datalist_type>>(
+         dest[Is], std::get<Offset + Is>(std::move(res))),
+     ...);
+  } else {
+    (this->produce<instance_type, list::at_t<Is, datalist_type>>(
+         std::get<Offset + Is>(std::move(res))),
+     ...);
+  }
+}
+
+template <typename Set, typename InstancesList>
+template <typename IS, typename DataList, typename T, std::size_t... Is>
+void interpreter<Set, InstancesList>::produce_registers(
+    std::array<std::size_t, sizeof...(Is)> const &dest, T &&arg,
+    std::index_sequence<Is...>) {
+  if constexpr (sizeof...(Is) == 1) {
+    this->write_register<IS, list::front_t<DataList>>(dest[0],
+                                                      std::forward<T>(arg));
+  } else {
+    (this->write_register<IS, list::at_t<Is, DataList>>(
+         dest[Is], std::get<Is>(std::forward<T>(arg))),
+     ...);
+  }
+}
+
+template <typename Set, typename InstancesList>
+template <typename IS, typename R, typename T>
+void interpreter<Set, InstancesList>::write_register(std::size_t index,
+                                                     T &&arg) {
+  if constexpr (concept ::is_code_reg_v<R>) {
+    std::get<IS>(m_instances).set(index, std::forward<T>(arg));
+  } else {
+    std::get<IS>(m_instances).template set<R::index>(std::forward<T>(arg));
+  }
+}
+
 template <typename Set, typename InstancesList>
 template <typename IS, typename V, typename T>
 void interpreter<Set, InstancesList>::produce(T &&arg) {
@@ -239,7 +674,7 @@ void interpreter<Set, InstancesList>::produce(T &&arg) {
         std::forward<T>(arg),
         std::make_index_sequence<std::tuple_size<T>::value>());
   } else if constexpr (concept ::is_container_valid_v<std::decay_t<T>>) {
-    for (auto sub : std::forward<T>(arg)) {
+    for (auto &sub : arg) {
       std::get<IS>(m_instances)
           .template push<typename V::value_type>(std::move(sub));
     }
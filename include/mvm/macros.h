@@ -14,6 +14,21 @@
 
 #pragma once
 
+// branch hints and attributes keeping failure paths out of hot code
+#if defined(__GNUC__) || defined(__clang__)
+#define MVM_COLD __attribute__((cold, noinline))
+#define MVM_LIKELY(x) __builtin_expect(!!(x), 1)
+#define MVM_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#elif defined(_MSC_VER)
+#define MVM_COLD __declspec(noinline)
+#define MVM_LIKELY(x) (x)
+#define MVM_UNLIKELY(x) (x)
+#else
+#define MVM_COLD
+#define MVM_LIKELY(x) (x)
+#define MVM_UNLIKELY(x) (x)
+#endif
+
 #define MVM_UNROLL_256(MACRO_TO_UNROLL)                                        \
   MACRO_TO_UNROLL(0)                                                           \
   MACRO_TO_UNROLL(1)                                                           \
@@ -0,0 +1,91 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "mvm/except.h"
+
+#include <cstddef>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mvm {
+
+///
+/// @brief Read only memory mapping of a whole file
+///
+/// Pages are loaded by the system when first read and can be dropped
+/// again under memory pressure, so large sources are never copied.
+///
+/// @warning posix only
+///
+class mapped_file {
+  void *m_mapping{nullptr};
+  std::size_t m_size{0};
+
+public:
+  explicit mapped_file(char const *path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+      throw_mexcept("[-][mvm] cannot open file", status_type::IO_ERROR);
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw_mexcept("[-][mvm] cannot stat file", status_type::IO_ERROR);
+    }
+
+    m_size = static_cast<std::size_t>(st.st_size);
+    if (m_size != 0) {
+      m_mapping = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+
+    if (m_mapping == MAP_FAILED) {
+      m_mapping = nullptr;
+      throw_mexcept("[-][mvm] cannot map file", status_type::IO_ERROR);
+    }
+    if (m_mapping) {
+      ::madvise(m_mapping, m_size, MADV_SEQUENTIAL);
+    }
+  }
+
+  ~mapped_file() {
+    if (m_mapping) {
+      ::munmap(m_mapping, m_size);
+    }
+  }
+
+  mapped_file(mapped_file &&other) noexcept
+      : m_mapping{std::exchange(other.m_mapping, nullptr)},
+        m_size{std::exchange(other.m_size, 0)} {}
+
+  mapped_file(mapped_file const &) = delete;
+  mapped_file &operator=(mapped_file const &) = delete;
+  mapped_file &operator=(mapped_file &&) = delete;
+
+  ///
+  /// @brief File content
+  ///
+  std::string_view view() const noexcept {
+    return {static_cast<char const *>(m_mapping), m_size};
+  }
+};
+} // namespace mvm
@@ -0,0 +1,169 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "mvm/except.h"
+#include "mvm/trace.h"
+#include "mvm/traits.h"
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace mvm {
+
+///
+/// @brief Heterogeneous value stack backed by a reserved memory mapping
+///
+/// The whole capacity is reserved once and pages are only committed by
+/// the system when they are first touched, so pushes never reallocate or
+/// move existing slots. Large values are stored in their slot too, there
+/// is no boxing arena. A PROT_NONE guard page follows the last slot.
+///
+/// @warning posix only
+///
+template <typename TypeList, std::size_t Capacity = (std::size_t{1} << 22)>
+class mapped_value_stack {
+  using value_stack_traits = traits::unboxed_stack_traits<TypeList>;
+  using value_type = typename value_stack_traits::value_type;
+
+  static_assert(Capacity > 0, "[-][mvm] mapped stack capacity must not be 0");
+
+  std::size_t m_mapped_size{0};
+  void *m_mapping{nullptr};
+  value_type *m_base{nullptr};
+  value_type *m_top{nullptr};
+  value_type *m_end{nullptr};
+
+public:
+  mapped_value_stack() {
+    auto page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    auto data_size =
+        (Capacity * sizeof(value_type) + page_size - 1) / page_size * page_size;
+    m_mapped_size = data_size + page_size;
+
+    m_mapping = ::mmap(nullptr, m_mapped_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (m_mapping == MAP_FAILED) {
+      throw std::bad_alloc{};
+    }
+
+    auto *bytes = static_cast<unsigned char *>(m_mapping);
+    if (::mprotect(bytes + data_size, page_size, PROT_NONE) != 0) {
+      ::munmap(m_mapping, m_mapped_size);
+      throw std::bad_alloc{};
+    }
+
+    m_base = reinterpret_cast<value_type *>(bytes);
+    m_top = m_base;
+    m_end = m_base + Capacity;
+  }
+
+  ~mapped_value_stack() {
+    if (!m_mapping) {
+      return;
+    }
+    while (m_top != m_base) {
+      (--m_top)->~value_type();
+    }
+    ::munmap(m_mapping, m_mapped_size);
+  }
+
+  mapped_value_stack(mapped_value_stack &&other) noexcept
+      : m_mapped_size{std::exchange(other.m_mapped_size, 0)},
+        m_mapping{std::exchange(other.m_mapping, nullptr)},
+        m_base{std::exchange(other.m_base, nullptr)},
+        m_top{std::exchange(other.m_top, nullptr)},
+        m_end{std::exchange(other.m_end, nullptr)} {}
+
+  mapped_value_stack(mapped_value_stack const &) = delete;
+  mapped_value_stack &operator=(mapped_value_stack const &) = delete;
+  mapped_value_stack &operator=(mapped_value_stack &&) = delete;
+
+  ///
+  /// @brief Push data to the stack
+  ///
+  template <typename T> void push(T &&val) {
+    LOG_INFO("mapped_value_stack -> push " << val << " on stack[" << this
+                                           << "]");
+    if (MVM_UNLIKELY(m_top == m_end)) {
+      throw_mexcept("[-][mvm] try to push to full stack",
+                    status_type::PUSH_FULL_STACK);
+    }
+    ::new (static_cast<void *>(m_top)) value_type(std::forward<T>(val));
+    ++m_top;
+  }
+
+  ///
+  /// @brief Pop data from the stack
+  ///
+  template <typename T> T pop() {
+    if (MVM_UNLIKELY(m_top == m_base)) {
+      throw_mexcept("[-][mvm] try to pop from empty stack",
+                    status_type::POP_EMPTY_STACK);
+    }
+    // a type mismatch leaves the stack untouched
+    if (MVM_UNLIKELY(!value_stack_traits::template holds<T>(*(m_top - 1)))) {
+      throw_mexcept("[-][mvm] try to pop a value of another type",
+                    status_type::BAD_VALUE_TYPE);
+    }
+    --m_top;
+    T val = value_stack_traits::template get_val<T>(std::move(*m_top));
+    m_top->~value_type();
+    LOG_INFO("mapped_value_stack -> pop from stack[" << this << "]");
+    return val;
+  }
+
+  ///
+  /// @brief Read the value at depth i without popping it, 0 being the top
+  ///
+  template <typename T> T const &peek(std::size_t i) const {
+    if (MVM_UNLIKELY(i >= this->size())) {
+      throw_mexcept("[-][mvm] try to peek past the bottom of the stack",
+                    status_type::POP_EMPTY_STACK);
+    }
+    auto const &val = *(m_top - 1 - i);
+    if (MVM_UNLIKELY(!value_stack_traits::template holds<T>(val))) {
+      throw_mexcept("[-][mvm] try to peek a value of another type",
+                    status_type::BAD_VALUE_TYPE);
+    }
+    return value_stack_traits::template peek_val<T>(val);
+  }
+
+  ///
+  /// @brief Replace the n top values by a single one
+  ///
+  template <typename T> void replace(std::size_t n, T &&val) {
+    if (MVM_UNLIKELY(n == 0 || n > this->size())) {
+      throw_mexcept("[-][mvm] try to pop from empty stack",
+                    status_type::POP_EMPTY_STACK);
+    }
+    for (std::size_t i = 1; i < n; ++i) {
+      (--m_top)->~value_type();
+    }
+    *(m_top - 1) = value_type(std::forward<T>(val));
+  }
+
+  ///
+  /// @brief Number of values on the stack
+  ///
+  std::size_t size() const noexcept {
+    return static_cast<std::size_t>(m_top - m_base);
+  }
+};
+} // namespace mvm
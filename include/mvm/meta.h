@@ -19,6 +19,7 @@
 #include "mvm/helpers/utils.h"
 #include "mvm/program.h"
 
+#include <string>
 #include <tuple>
 #include <type_traits>
 
@@ -34,6 +35,21 @@ template <typename Instance> struct meta_value_stack {};
 // second mandatory meta concept is bytecode to interpret
 template <typename Instance> struct meta_bytecode {};
 
+// optional meta concept for register based instruction sets
+template <typename Instance> struct meta_register_file {};
+
+// register operand with an index fixed at compile time
+template <std::size_t I, typename T> struct reg {
+  static constexpr std::size_t index = I;
+  using value_type = T;
+};
+
+// register operand with an index read from the bytecode
+template <typename IndexT, typename T> struct code_reg {
+  using index_type = IndexT;
+  using value_type = T;
+};
+
 template <typename... Ts> using meta_type_list = list::mplist<Ts...>;
 
 // bind a meta concept and a list of types to handle
@@ -91,11 +107,39 @@ using no_cons = consumers<>;
 
 namespace details {
 
+// type seen by instruction callbacks for a meta data type
+template <typename T> struct operand_type { using type = T; };
+
+template <std::size_t I, typename T> struct operand_type<reg<I, T>> {
+  using type = T;
+};
+
+template <typename IndexT, typename T>
+struct operand_type<code_reg<IndexT, T>> {
+  using type = T;
+};
+
+template <typename T> using operand_type_t = typename operand_type<T>::type;
+
+// in order concatenation of mplists
+template <typename... Lists> struct join { using type = list::mplist<>; };
+
+template <typename... Ts> struct join<list::mplist<Ts...>> {
+  using type = list::mplist<Ts...>;
+};
+
+template <typename... Ts, typename... Us, typename... Lists>
+struct join<list::mplist<Ts...>, list::mplist<Us...>, Lists...>
+    : join<list::mplist<Ts..., Us...>, Lists...> {};
+
+template <typename... Lists> using join_t = typename join<Lists...>::type;
+
 template <typename T> struct flatten_tie_types;
 
 template <template <typename...> typename T, typename... MetaTie>
 struct flatten_tie_types<T<MetaTie...>> {
-  using type = list::concat_all_t<typename MetaTie::meta_data_type...>;
+  using type = list::concat_all_t<
+      list::map_t<operand_type_t, typename MetaTie::meta_data_type>...>;
 };
 
 template <template <typename...> typename T> struct flatten_tie_types<T<>> {
@@ -105,6 +149,18 @@ template <template <typename...> typename T> struct flatten_tie_types<T<>> {
 template <typename T>
 using flatten_tie_types_t = typename flatten_tie_types<T>::type;
 
+// handler results keep the declaration order of producers
+template <typename T> struct ordered_tie_types;
+
+template <template <typename...> typename T, typename... MetaTie>
+struct ordered_tie_types<T<MetaTie...>> {
+  using type =
+      join_t<list::map_t<operand_type_t, typename MetaTie::meta_data_type>...>;
+};
+
+template <typename T>
+using ordered_tie_types_t = typename ordered_tie_types<T>::type;
+
 template <typename C, typename Ret, typename ArgList> struct prototype;
 
 template <typename C, typename Ret, typename... Args>
@@ -130,15 +186,24 @@ struct desc_to_proto;
 
 template <typename Set, typename Producer, typename Consumer>
 struct desc_to_proto<Set, Producer, Consumer, false>
-    : prototype_builder<Set, flatten_tie_types_t<Producer>,
+    : prototype_builder<Set, ordered_tie_types_t<Producer>,
                         flatten_tie_types_t<Consumer>> {};
 
 template <typename Set, typename Producer, typename Consumer>
 struct desc_to_proto<Set, Producer, Consumer, true>
     : prototype_builder<
-          Set, flatten_tie_types_t<Producer>,
+          Set, ordered_tie_types_t<Producer>,
           list::push_front_t<ip &, flatten_tie_types_t<Consumer>>> {};
 
+// in place handlers read their operands directly from the stack slots
+template <typename T> using const_ref_t = T const &;
+
+template <typename Set, typename Producer, typename Consumer>
+struct desc_to_ref_proto
+    : prototype_builder<
+          Set, ordered_tie_types_t<Producer>,
+          list::map_t<const_ref_t, flatten_tie_types_t<Consumer>>> {};
+
 template <typename T> struct unwrap_type { using type = std::decay_t<T>; };
 
 template <template <typename...> typename Container, typename T, typename... Ts>
@@ -146,12 +211,30 @@ struct unwrap_type<Container<T, Ts...>> {
   using type = std::decay_t<T>;
 };
 
+// strings are handled as single values
+template <typename C, typename Traits, typename Alloc>
+struct unwrap_type<std::basic_string<C, Traits, Alloc>> {
+  using type = std::basic_string<C, Traits, Alloc>;
+};
+
 template <typename T> using unwrap_type_t = typename unwrap_type<T>::type;
 
-template <typename Consumer> struct bytecode_types {
+template <typename T> struct code_index_types { using type = list::mplist<>; };
+
+template <typename IndexT, typename T>
+struct code_index_types<code_reg<IndexT, T>> {
+  using type = list::mplist<IndexT>;
+};
+
+template <typename MetaTie> struct bytecode_types {
   using type = list::mplist<>;
 };
 
+template <template <typename> typename Meta, typename... Ts>
+struct bytecode_types<meta_tie<Meta, Ts...>> {
+  using type = join_t<typename code_index_types<Ts>::type...>;
+};
+
 template <typename... Ts>
 struct bytecode_types<consumer<meta_bytecode, Ts...>> {
   using type = list::mplist<Ts...>;
@@ -164,6 +247,13 @@ struct bytecode_types<iterable_consumer<
   using type = list::mplist<CounterT>;
 };
 
+template <typename MetaTieList> struct bytecode_types_aggregator;
+
+template <template <typename...> typename T, typename... MetaTie>
+struct bytecode_types_aggregator<T<MetaTie...>> {
+  using type = join_t<typename bytecode_types<MetaTie>::type...>;
+};
+
 template <typename Producer> struct value_stack_types {
   using type = list::mplist<>;
 };
@@ -286,12 +376,17 @@ template <typename ITable>
 using set_stack_types_t =
     typename details::set_stack_types_aggregator<ITable>::type;
 
-// retrieve a type list of all types consumes in the bytecode for an instruction
-// set
-template <typename Consumers>
+// retrieve the ordered type list of all types read from the bytecode by a
+// list of consumers or producers
+template <typename MetaTieList>
 using bytecode_types_t =
-    typename details::types_aggregator<details::bytecode_types,
-                                       Consumers>::type;
+    typename details::bytecode_types_aggregator<MetaTieList>::type;
+
+// retrieve the ordered type list of all operands of an instruction in the
+// bytecode, producers register indexes come first
+template <typename Producers, typename Consumers>
+using instr_bytecode_types_t =
+    details::join_t<bytecode_types_t<Producers>, bytecode_types_t<Consumers>>;
 
 // aggregates all instruction names of an instruction set
 template <typename ISet, typename I> struct names_aggregator;
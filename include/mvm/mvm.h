@@ -15,6 +15,7 @@
 #pragma once
 
 #include "mvm/bytecode_serializer.h"
+#include "mvm/code_sink.h"
 #include "mvm/except.h"
 #include "mvm/helpers/list.h"
 #include "mvm/helpers/reflect.h"
@@ -22,10 +23,19 @@
 #include "mvm/helpers/utils.h"
 #include "mvm/instr_set.h"
 #include "mvm/meta.h"
+#include "mvm/opcode_profile.h"
+#include "mvm/profiled_stack.h"
 #include "mvm/program.h"
+#include "mvm/reg_interpreter.h"
+#include "mvm/register_file.h"
 #include "mvm/status.h"
 #include "mvm/trace.h"
 #include "mvm/traits.h"
 #include "mvm/types.h"
 #include "mvm/value_stack.h"
-#include "mvm/vm.h"
\ No newline at end of file
+#include "mvm/vm.h"
+
+#ifndef _WIN32
+#include "mvm/mapped_file.h"
+#include "mvm/mapped_value_stack.h"
+#endif
\ No newline at end of file
@@ -0,0 +1,67 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+namespace mvm {
+
+///
+/// @brief Execution count of each instruction of a set
+///
+template <std::size_t N> struct opcode_profile {
+  // number of executions indexed by instruction index
+  std::array<std::uint64_t, N> counts{};
+};
+
+namespace traits {
+
+///
+/// @brief Execution counts of an instruction set known at compile time
+///
+/// Specialized by the header generated with write_opcode_profile, the
+/// specialization holds a static constexpr array named value.
+///
+template <typename Set> struct opcode_counts {};
+} // namespace traits
+
+///
+/// @brief Generate a header feeding a profiling run back to the build
+///
+/// The header specializes traits::opcode_counts for the set and must be
+/// included after the set definition, before the set is used.
+///
+/// @param set_name fully qualified name of the instruction set type
+///
+template <std::size_t N>
+void write_opcode_profile(std::ostream &os, std::string_view set_name,
+                          opcode_profile<N> const &profile) {
+  os << "// generated by mvm::write_opcode_profile, do not edit\n"
+     << "#pragma once\n\n"
+     << "#include \"mvm/opcode_profile.h\"\n\n"
+     << "template <> struct mvm::traits::opcode_counts<" << set_name
+     << "> {\n"
+     << "  static constexpr std::array<std::uint64_t, " << N
+     << "> value = {";
+  for (std::size_t i = 0; i < N; ++i) {
+    os << (i ? ", " : "") << profile.counts[i] << "u";
+  }
+  os << "};\n};\n";
+}
+} // namespace mvm
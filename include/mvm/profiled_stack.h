@@ -0,0 +1,115 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "mvm/except.h"
+#include "mvm/helpers/reflect.h"
+
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <utility>
+
+namespace mvm {
+
+///
+/// @brief Stack usage of a program
+///
+/// One entry per instance of the vm instance list, entries of instances
+/// that are not profiled stacks stay at 0.
+///
+template <std::size_t N> struct stack_profile {
+  // max depth reached by each stack
+  std::array<std::size_t, N> high_water{};
+  // set when a run went deeper than the recorded high water mark
+  bool grown{false};
+  // forbid runs to go deeper than the recorded high water mark
+  bool fixed_capacity{false};
+};
+
+///
+/// @brief Stack decorator recording the max depth reached
+///
+/// Use it in an instance list to opt in stack profiling, for instance
+/// meta_value_stack<profiled_stack<value_stack<...>>>
+///
+template <typename Stack> class profiled_stack : public Stack {
+  std::size_t m_base{0};
+  std::size_t m_depth{0};
+  std::size_t m_high_water{0};
+  std::size_t m_capacity{std::numeric_limits<std::size_t>::max()};
+
+public:
+  using Stack::Stack;
+
+  ///
+  /// @brief Push data to the stack
+  ///
+  template <typename T> void push(T &&val) {
+    if (MVM_UNLIKELY(m_depth == m_capacity)) {
+      throw_mexcept("[-][mvm] try to push to full stack",
+                    status_type::PUSH_FULL_STACK);
+    }
+    Stack::push(std::forward<T>(val));
+    if (++m_depth > m_high_water) {
+      m_high_water = m_depth;
+    }
+  }
+
+  ///
+  /// @brief Pop data from the stack
+  ///
+  template <typename T> T pop() {
+    T val = Stack::template pop<T>();
+    --m_depth;
+    return val;
+  }
+
+  ///
+  /// @brief Replace the n top values by a single one
+  ///
+  template <typename T>
+  auto replace(std::size_t n, T &&val)
+      -> decltype(std::declval<Stack &>().replace(n, std::forward<T>(val))) {
+    Stack::replace(n, std::forward<T>(val));
+    m_depth -= n - 1;
+  }
+
+  ///
+  /// @brief Max depth reached since last prepare, relative to the depth
+  /// at that time
+  ///
+  std::size_t high_water_mark() const noexcept {
+    return m_high_water - m_base;
+  }
+
+  ///
+  /// @brief Size the stack before a run
+  ///
+  /// @param depth expected max depth, used as a reserve hint
+  /// @param fixed if true, the depth becomes a hard capacity
+  ///
+  void prepare(std::size_t depth, bool fixed) {
+    m_base = m_depth;
+    m_high_water = m_depth;
+    m_capacity =
+        fixed ? m_depth + depth : std::numeric_limits<std::size_t>::max();
+
+    if constexpr (reflect::has_reserve(reflect::type<Stack>, std::size_t{})) {
+      Stack::reserve(m_depth + depth);
+    }
+  }
+};
+} // namespace mvm
@@ -19,6 +19,8 @@
 
 #include <cstdint>
 #include <limits>
+#include <memory>
+#include <memory_resource>
 #include <vector>
 
 namespace mvm {
@@ -68,8 +70,8 @@ public:
 
 private:
   void increment(uintptr_t inc) {
-    if (m_val > (std::numeric_limits<uintptr_t>::max() - inc)) {
-      throw mexcept{"[-][mvm] bytecode overflow", status_type::CODE_OVERFLOW};
+    if (MVM_UNLIKELY(m_val > (std::numeric_limits<uintptr_t>::max() - inc))) {
+      throw_mexcept("[-][mvm] bytecode overflow", status_type::CODE_OVERFLOW);
     }
 
     m_val += inc;
@@ -78,8 +80,8 @@ private:
   }
 
   void decrement(uintptr_t dec) {
-    if (m_val < dec) {
-      throw mexcept{"[-][mvm] bytecode overflow", status_type::CODE_OVERFLOW};
+    if (MVM_UNLIKELY(m_val < dec)) {
+      throw_mexcept("[-][mvm] bytecode overflow", status_type::CODE_OVERFLOW);
     }
 
     m_val -= dec;
@@ -129,9 +131,19 @@ public:
 ///
 /// @brief Program data
 ///
-struct prog_chunk {
-  prog_chunk() = default;
-  explicit prog_chunk(std::vector<uint8_t> &&c) : code{std::move(c)} {};
-  std::vector<uint8_t> code;
+template <typename Alloc> struct basic_prog_chunk {
+  using allocator_type = Alloc;
+  using code_type = std::vector<uint8_t, allocator_type>;
+
+  basic_prog_chunk() = default;
+  explicit basic_prog_chunk(allocator_type const &alloc) : code{alloc} {}
+  explicit basic_prog_chunk(code_type &&c) : code{std::move(c)} {};
+  code_type code;
 };
+
+using prog_chunk = basic_prog_chunk<std::allocator<uint8_t>>;
+
+namespace pmr {
+using prog_chunk = basic_prog_chunk<std::pmr::polymorphic_allocator<uint8_t>>;
+} // namespace pmr
 } // namespace mvm
@@ -0,0 +1,1240 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "mvm/concept.h"
+#include "mvm/except.h"
+#include "mvm/instr_set.h"
+#include "mvm/meta.h"
+#include "mvm/program.h"
+#include "mvm/trace.h"
+#include "mvm/traits.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace mvm {
+namespace details {
+
+// data read by an instruction, in consumption order
+template <typename T> struct code_arg { using type = T; };
+
+template <typename T> struct stack_arg { using type = T; };
+
+template <typename Iterable, typename CounterT> struct iter_arg {
+  using type = std::decay_t<Iterable>;
+  using counter_type = CounterT;
+};
+
+struct unsupported_arg {
+  using type = unsupported_arg;
+};
+
+template <typename Consumer> struct reg_args {
+  using type = list::mplist<unsupported_arg>;
+};
+
+template <typename... Ts> struct reg_args<consumer<meta_bytecode, Ts...>> {
+  using type = list::mplist<code_arg<Ts>...>;
+};
+
+template <typename... Ts> struct reg_args<consumer<meta_value_stack, Ts...>> {
+  using type = list::mplist<stack_arg<Ts>...>;
+};
+
+template <typename Iterable, typename CounterT>
+struct reg_args<
+    iterable_consumer<meta_value_stack, Iterable,
+                      count_from<consumer<meta_bytecode, CounterT>>>> {
+  using type = list::mplist<iter_arg<Iterable, CounterT>>;
+};
+
+template <typename Consumers> struct reg_args_aggregator;
+
+template <typename... Cs> struct reg_args_aggregator<consumers<Cs...>> {
+  using type = join_t<list::mplist<>, typename reg_args<Cs>::type...>;
+};
+
+// data read by an instruction, in the order the interpreter consumes them
+template <typename I>
+using reg_args_t =
+    typename reg_args_aggregator<typename I::consumers_type>::type;
+
+template <typename Producers> struct is_reg_producers : std::false_type {};
+
+template <> struct is_reg_producers<no_prod> : std::true_type {};
+
+template <typename... Ts>
+struct is_reg_producers<producers<producer<meta_value_stack, Ts...>>>
+    : std::true_type {};
+
+template <typename T>
+struct is_supported_arg
+    : std::bool_constant<!std::is_same_v<T, unsupported_arg>> {};
+
+// an instruction can be translated if it only uses the bytecode and the
+// value stack
+template <typename I>
+struct is_reg_translatable
+    : std::bool_constant<
+          list::check_v<is_supported_arg, reg_args_t<I>> &&
+          is_reg_producers<typename I::producers_type>::value> {};
+
+// register slot type for a list of stack types
+template <typename TypeList, std::size_t = list::size_v<TypeList>>
+struct reg_value {
+  using type = list::rebind_t<std::variant, TypeList>;
+};
+
+template <typename TypeList> struct reg_value<TypeList, 1> {
+  using type = list::front_t<TypeList>;
+};
+
+template <typename TypeList> struct reg_value<TypeList, 0> {
+  using type = std::monostate;
+};
+
+// position of a type in a stack type list
+template <typename T, typename TypeList> struct reg_alt;
+
+template <typename T, typename... Ts> struct reg_alt<T, list::mplist<Ts...>> {
+  static constexpr std::uint8_t value = [] {
+    std::uint8_t i{0};
+    (void)((std::is_same_v<T, Ts> ? false : (++i, true)) && ...);
+    return i;
+  }();
+};
+} // namespace details
+
+///
+/// @brief Promotion thresholds of the register interpreter tiers
+///
+struct tier_thresholds {
+  // entries of a block before it is translated, 0 translates at load
+  std::uint32_t block{8};
+  // backward jumps to a block before its loop is traced, 0 disables traces
+  std::uint32_t trace{16};
+};
+
+///
+/// @brief Register based interpreter
+///
+/// Alternative execution tier for instruction sets working on the bytecode
+/// and the value stack. At load time, the stack bytecode is translated
+/// block by block into a register IR: every value stack slot becomes a
+/// virtual register whose position is computed from the consumers and
+/// producers signature of the instructions. Pipes are not executed anymore,
+/// their immediates are folded into the operands of the instructions
+/// reading them, and stack bound checks are done once per block.
+///
+/// The IR calls the handlers of the instruction set, so the same set can be
+/// run by both interpreters.
+///
+/// For multiple type stacks, IR instructions are quickened: once an
+/// instruction ran, it is patched with a form reading its operands without
+/// variant checks. Operands coming from outside of the block are guarded
+/// by a check of their alternative, a failed guard patches the generic
+/// form back. Instructions whose operands are all produced in the block
+/// with the expected stack type are quickened at load time.
+///
+/// Backward jump targets are counted. When a target gets hot, the blocks
+/// run until the next jump back to it are recorded and translated again
+/// as a single trace. Jumps and variable producers of the trace are kept
+/// as guards checking that the recorded path is still followed, the trace
+/// runs until a guard fails.
+///
+/// Nothing is translated at load. Cold blocks are run by a direct dispatch
+/// on their opcodes, reading and writing the stack slots, until they have
+/// been entered enough times. They are translated only then, so cold code
+/// never pays for it. A block threshold of 0 translates the fall through
+/// chain at load instead.
+///
+/// @note blocks end after instructions updating ip or producing a variable
+///       number of values. Jump targets are translated on first use.
+/// @warning the chunk must outlive the loaded program
+///
+template <typename Set, typename InstanceList> class reg_interpreter {
+  using instr_set_type = Set;
+  using instr_set_traits_type =
+      typename traits::instr_set_traits<instr_set_type>;
+  using instr_set_desc_type =
+      typename instr_set_traits_type::instr_set_desc_type;
+  using bytecode_serializer_type = instance_of_t<InstanceList, meta_bytecode>;
+  using stack_types = typename instr_set_traits_type::set_stack_type;
+  using value_type = typename details::reg_value<stack_types>::type;
+
+  static constexpr bool is_variant = list::size_v<stack_types> > 1;
+
+  // operand of an IR instruction, either a slot relative to the stack
+  // depth at block entry or a folded immediate
+  struct operand_ref {
+    bool is_const;
+    std::int32_t index;
+    // stack type known at translation time
+    bool typed;
+    // stack type position, the actual one if typed, else the one expected
+    // by the reader
+    std::uint8_t alt;
+  };
+
+  struct reg_instr;
+  using exec_type = void (*)(reg_interpreter &, reg_instr &);
+
+  struct reg_instr {
+    exec_type exec;
+    // bytecode offset and size of the translated instruction
+    std::uint32_t offset;
+    std::uint32_t size;
+    // operands in the operand table
+    std::uint32_t first;
+    std::uint32_t count;
+    // slot of the first produced value
+    std::int32_t base;
+    // lowest slot read since block entry
+    std::int32_t min_slot;
+    // operands read without variant checks
+    bool quick;
+    // some operands need a type guard
+    bool guarded;
+  };
+
+  // immediates left on the stack (slot, constant)
+  using spills_type = std::vector<std::pair<std::int32_t, std::uint32_t>>;
+
+  // side exit of a trace
+  struct reg_exit {
+    // instructions run before the check
+    std::uint32_t end;
+    // recorded ip offset or number of produced values
+    std::uint32_t expected;
+    // offset to resume from after a variable producer
+    std::uint32_t next_offset;
+    // stack depth variation, from the instruction base if dynamic
+    std::int32_t delta;
+    bool dynamic;
+    spills_type spills;
+  };
+
+  // translated loop of a hot jump target
+  struct reg_trace {
+    std::vector<reg_instr> instrs;
+    std::vector<reg_exit> exits;
+    std::int32_t min_slot{0};
+    std::int32_t max_slot{0};
+  };
+
+  struct reg_block {
+    std::vector<reg_instr> instrs;
+    spills_type spills;
+    std::int32_t min_slot{0};
+    std::int32_t max_slot{0};
+    // stack depth variation, from the last instruction base if dynamic
+    std::int32_t delta{0};
+    std::uint32_t offset{0};
+    std::uint32_t next_offset{0};
+    bool update_ip{false};
+    bool dynamic{false};
+    status_type trap{status_type::SUCCESS};
+    // backward jumps to this block
+    std::uint32_t hits{0};
+    reg_trace *trace{nullptr};
+  };
+
+  // translation state of the block or trace being built
+  struct block_builder {
+    std::vector<reg_instr> &instrs;
+    std::uint32_t offset;
+    std::int32_t depth{0};
+    std::int32_t min_slot{0};
+    std::int32_t max_slot{0};
+    // immediates and slots written since the start, by slot
+    std::map<std::int32_t, operand_ref> known{};
+    bool ended{false};
+    bool update_ip{false};
+    bool dynamic{false};
+    // stack type of the values of a variable producer
+    operand_ref produced{false, 0, false, 0};
+    status_type trap{status_type::SUCCESS};
+
+    operand_ref pop() {
+      --depth;
+      min_slot = std::min(min_slot, depth);
+      auto it = known.find(depth);
+      if (it == known.end()) {
+        return {false, depth, false, 0};
+      }
+      auto ref = it->second;
+      known.erase(it);
+      return ref;
+    }
+
+    void push(operand_ref ref) {
+      if (ref.is_const || ref.typed) {
+        if (!ref.is_const) {
+          ref.index = depth;
+        }
+        known[depth] = ref;
+      }
+      ++depth;
+      max_slot = std::max(max_slot, depth);
+    }
+
+    spills_type spills() const {
+      spills_type res;
+      for (auto const &k : known) {
+        if (k.second.is_const) {
+          res.emplace_back(k.first,
+                           static_cast<std::uint32_t>(k.second.index));
+        }
+      }
+      return res;
+    }
+
+    void end() { ended = true; }
+  };
+
+  static constexpr std::size_t max_trace_blocks = 32;
+  static constexpr std::uint32_t end_offset =
+      std::numeric_limits<std::uint32_t>::max();
+
+  instr_set_type &m_iset;
+  bytecode_serializer_type m_serializer;
+  rebasable_ip m_rebased_ip;
+
+  uint8_t const *m_code{nullptr};
+  std::size_t m_code_size{0};
+  std::unordered_map<std::uint32_t, reg_block> m_blocks;
+  std::vector<operand_ref> m_operands;
+  std::vector<value_type> m_consts;
+
+  std::unordered_map<std::uint32_t, reg_trace> m_traces;
+  std::vector<std::pair<std::uint32_t, std::size_t>> m_trace_path;
+  reg_block *m_trace_head{nullptr};
+
+  tier_thresholds m_tiers;
+  // entries of blocks not translated yet
+  std::unordered_map<std::uint32_t, std::uint32_t> m_entries;
+
+  std::vector<value_type> m_slots;
+  std::size_t m_depth{0};
+  std::size_t m_produced{0};
+
+public:
+  explicit reg_interpreter(instr_set_type &iset) : m_iset{iset} {}
+
+  ///
+  /// @brief Translate code chunk, previously loaded program is dropped
+  ///
+  template <typename Alloc> void load(basic_prog_chunk<Alloc> const &c);
+
+  ///
+  /// @brief Run loaded program
+  ///
+  void run();
+
+  ///
+  /// @brief Number of IR instructions of the translated blocks
+  ///
+  std::size_t instr_count() const noexcept {
+    std::size_t count{0};
+    for (auto const &b : m_blocks) {
+      count += b.second.instrs.size();
+    }
+    return count;
+  }
+
+  ///
+  /// @brief Number of quickened IR instructions
+  ///
+  std::size_t quick_count() const noexcept {
+    std::size_t count{0};
+    for (auto const &b : m_blocks) {
+      count += static_cast<std::size_t>(
+          std::count_if(b.second.instrs.begin(), b.second.instrs.end(),
+                        [](auto const &ri) { return ri.quick; }));
+    }
+    return count;
+  }
+
+  ///
+  /// @brief Number of traces built for hot loops
+  ///
+  std::size_t trace_count() const noexcept { return m_traces.size(); }
+
+  ///
+  /// @brief Number of translated blocks
+  ///
+  std::size_t block_count() const noexcept { return m_blocks.size(); }
+
+  ///
+  /// @brief Set promotion thresholds, used from the next load
+  ///
+  void set_tiers(tier_thresholds const &tiers) noexcept { m_tiers = tiers; }
+
+  ///
+  /// @brief Number of values on the stack
+  ///
+  std::size_t size() const noexcept { return m_depth; }
+
+private:
+  using translate_type = void (reg_interpreter::*)(block_builder &);
+
+  using step_type = bool (reg_interpreter::*)(std::uint32_t &);
+
+  template <std::size_t... Is>
+  static constexpr std::array<translate_type, sizeof...(Is)>
+  make_translate_table(std::index_sequence<Is...>) {
+    return {&reg_interpreter::translate_instr<
+        list::at_t<Is, instr_set_desc_type>>...};
+  }
+
+  template <std::size_t... Is>
+  static constexpr std::array<step_type, sizeof...(Is)>
+  make_step_table(std::index_sequence<Is...>) {
+    return {
+        &reg_interpreter::step_instr<list::at_t<Is, instr_set_desc_type>>...};
+  }
+
+  // translate block starting at offset if not already done
+  reg_block &block_at(std::uint32_t offset);
+
+  // translated block at offset, null while the block is cold
+  reg_block *block_for(std::uint32_t offset) {
+    auto it = m_blocks.find(offset);
+    if (it != m_blocks.end()) {
+      return &it->second;
+    }
+    if (m_tiers.block && ++m_entries[offset] < m_tiers.block) {
+      return nullptr;
+    }
+    return &this->block_at(offset);
+  }
+
+  // copy translation state to a block
+  void seal(reg_block &block, block_builder const &b, std::uint32_t offset);
+
+  // translate instructions up to the end of a block
+  void translate(block_builder &b) {
+    while (!b.ended && b.offset < m_code_size) {
+      this->translate_one(b);
+    }
+  }
+
+  // translate the instruction at the builder offset
+  void translate_one(block_builder &b);
+
+  // opcode of the instruction at offset, moved to its last opcode byte
+  status_type decode(std::uint32_t &offset, std::size_t &opcode) const {
+    opcode = m_code[offset];
+    if (instr_set_traits_type::is_extended &&
+        opcode == instr_set_traits_type::opcode_escape) {
+      if (offset + 1 >= m_code_size) {
+        return status_type::CODE_OVERFLOW;
+      }
+      opcode = instr_set_traits_type::short_opcode_count + m_code[++offset];
+    }
+    return opcode < list::size_v<instr_set_desc_type>
+               ? status_type::SUCCESS
+               : status_type::INVALID_INSTR_OPCODE;
+  }
+
+  // translate single instruction
+  template <typename I> void translate_instr(block_builder &b);
+
+  // translate recorded path starting at a hot block
+  void compile_trace(reg_block &head);
+
+  // execute single block and return the next offset
+  std::uint32_t execute(reg_block &b);
+
+  // execute cold block by direct dispatch on its opcodes
+  std::uint32_t run_cold(std::uint32_t offset);
+
+  // execute single instruction on the stack slots, move offset to the
+  // next one and return true at the end of a block
+  template <typename I> bool step_instr(std::uint32_t &offset);
+
+  template <typename I, typename... Args>
+  void step_args(std::uint32_t offset, list::mplist<Args...>);
+
+  // pop a single handler argument from the stack slots
+  template <typename Arg> typename Arg::type take(std::size_t &code);
+
+  value_type &pop_slot() {
+    if (MVM_UNLIKELY(!m_depth)) {
+      throw_mexcept("[-][mvm] try to pop from empty stack",
+                    status_type::POP_EMPTY_STACK);
+    }
+    return m_slots[--m_depth];
+  }
+
+  // count backward jumps and record hot loops
+  void profile(reg_block const &b, std::uint32_t next);
+
+  // execute trace until a guard fails and return the next offset
+  std::uint32_t run_trace(reg_block &head);
+
+  // write back immediates and update depth when leaving a trace
+  void leave(reg_exit const &e, std::ptrdiff_t depth, std::size_t produced) {
+    for (auto const &s : e.spills) {
+      this->slot(s.first) = m_consts[s.second];
+    }
+    m_depth = static_cast<std::size_t>(depth + e.delta) + produced;
+  }
+
+  std::uint32_t ip_offset() const {
+    if (!m_rebased_ip.assert_in_chunk()) {
+      return end_offset;
+    }
+    return static_cast<std::uint32_t>(static_cast<uintptr_t>(m_rebased_ip) -
+                                      reinterpret_cast<uintptr_t>(m_code));
+  }
+
+  // execute single IR instruction, quickened after first run
+  template <typename I>
+  static void exec_instr(reg_interpreter &self, reg_instr &ri) {
+    self.exec_args<I, true>(ri, details::reg_args_t<I>{});
+    if constexpr (is_variant) {
+      ri.exec = &reg_interpreter::exec_quick<I>;
+      ri.quick = true;
+    }
+  }
+
+  // execute single IR instruction without variant checks
+  template <typename I>
+  static void exec_quick(reg_interpreter &self, reg_instr &ri) {
+    if (ri.guarded && !self.check_types(ri)) {
+      // deoptimize, the generic form reports the error
+      LOG_INFO("reg_interpreter -> deoptimize instruction "
+               << typestring::char_seq<typename I::name_type>::value);
+      ri.exec = &reg_interpreter::exec_instr<I>;
+      ri.quick = false;
+      exec_instr<I>(self, ri);
+      return;
+    }
+    self.exec_args<I, false>(ri, details::reg_args_t<I>{});
+  }
+
+  // check stack types of the operands of an instruction
+  bool check_types(reg_instr const &ri) {
+    for (auto i = ri.first; i < ri.first + ri.count; ++i) {
+      auto const &ref = m_operands[i];
+      if (ref.typed) {
+        continue;
+      }
+      auto const &val = ref.is_const
+                            ? m_consts[static_cast<std::size_t>(ref.index)]
+                            : this->slot(ref.index);
+      if (val.index() != ref.alt) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  template <typename I, bool Checked, typename... Args>
+  void exec_args(reg_instr const &ri, list::mplist<Args...>);
+
+  // call the handler, last is the offset of the last instruction byte
+  template <typename I, typename Tuple, std::size_t... Is>
+  auto call(std::uint32_t last, Tuple &&args, std::index_sequence<Is...>);
+
+  // read a single handler argument
+  template <typename Arg, bool Checked>
+  typename Arg::type fetch(std::uint32_t &operand, std::size_t &code);
+
+  template <typename T, bool Checked> T read(operand_ref ref) {
+    if (ref.is_const) {
+      return get<T, Checked>(m_consts[static_cast<std::size_t>(ref.index)]);
+    }
+    return get<T, Checked>(std::move(this->slot(ref.index)));
+  }
+
+  template <typename T, bool Checked, typename V> static T get(V &&val) {
+    if constexpr (std::is_same_v<std::decay_t<V>, T>) {
+      return std::forward<V>(val);
+    } else {
+      auto *ptr = std::get_if<T>(&val);
+      if constexpr (Checked) {
+        // same error as a pop from the value stack
+        if (MVM_UNLIKELY(!ptr)) {
+          throw_mexcept("[-][mvm] try to pop a value of another type",
+                        status_type::BAD_VALUE_TYPE);
+        }
+      }
+      // the alternative is known or checked, get_if result is never null
+      if constexpr (std::is_lvalue_reference_v<V>) {
+        return *ptr;
+      } else {
+        return std::move(*ptr);
+      }
+    }
+  }
+
+  template <typename T> static constexpr std::uint8_t alt_of() {
+    if constexpr (is_variant) {
+      return details::reg_alt<T, stack_types>::value;
+    } else {
+      return 0;
+    }
+  }
+
+  // operand ref of a value of type T written at translation time, its
+  // stack type is unknown if T is not one of the stack types
+  template <typename T>
+  static constexpr operand_ref known_ref(bool is_const, std::int32_t index) {
+    constexpr auto alt = alt_of<std::decay_t<T>>();
+    return {is_const, index, alt < list::size_v<stack_types>, alt};
+  }
+
+  // operand ref read by an instruction expecting a value of type T
+  template <typename T> static operand_ref expect(operand_ref ref) {
+    constexpr auto alt = alt_of<T>();
+    if (ref.alt != alt) {
+      // not known or known to be wrong, checked at run time
+      ref.typed = false;
+      ref.alt = alt;
+    }
+    return ref;
+  }
+
+  template <typename... Ts>
+  static constexpr std::array<operand_ref, sizeof...(Ts)>
+  produced_refs(list::mplist<Ts...>) {
+    return {known_ref<Ts>(false, 0)...};
+  }
+
+  // write produced values to the slots from base
+  template <typename DataList, typename R>
+  void write(std::int32_t base, R &&res);
+
+  value_type &slot(std::int32_t index) {
+    return m_slots[static_cast<std::size_t>(
+        static_cast<std::ptrdiff_t>(m_depth) + index)];
+  }
+
+  template <typename T> T parse(std::size_t offset) const {
+    return m_serializer.template parse<
+        T, instr_set_traits_type::template type_size<T>,
+        typename instr_set_traits_type::template type_endianness<T>>(
+        m_code + offset);
+  }
+};
+
+///////////////////////////////////////////////////////////////
+// Implementation
+///////////////////////////////////////////////////////////////
+
+template <typename Set, typename InstanceList>
+template <typename Alloc>
+void reg_interpreter<Set, InstanceList>::load(
+    basic_prog_chunk<Alloc> const &c) {
+  static_assert(
+      list::check_v<details::is_reg_translatable, instr_set_desc_type>,
+      "[-][mvm] instruction set must only use bytecode and value stack "
+      "instances");
+
+  m_blocks.clear();
+  m_operands.clear();
+  m_consts.clear();
+  m_traces.clear();
+  m_entries.clear();
+  m_code = c.code.data();
+  m_code_size = c.code.size();
+
+  if (!m_code_size) {
+    return;
+  }
+
+  m_rebased_ip.rebase(m_code, m_code + m_code_size - 1);
+
+  if (!m_tiers.block) {
+    // translate the fall through chain, jump targets are done on demand
+    for (std::uint32_t offset = 0; offset < m_code_size;) {
+      auto &b = this->block_at(offset);
+      if (b.trap != status_type::SUCCESS) {
+        break;
+      }
+      offset = b.next_offset;
+    }
+  }
+}
+
+template <typename Set, typename InstanceList>
+typename reg_interpreter<Set, InstanceList>::reg_block &
+reg_interpreter<Set, InstanceList>::block_at(std::uint32_t offset) {
+  auto [it, inserted] = m_blocks.try_emplace(offset);
+  auto &block = it->second;
+  if (!inserted) {
+    return block;
+  }
+
+  LOG_INFO("reg_interpreter -> translate block at " << offset);
+
+  block_builder b{block.instrs, offset};
+  this->translate(b);
+  this->seal(block, b, offset);
+
+  return block;
+}
+
+template <typename Set, typename InstanceList>
+void reg_interpreter<Set, InstanceList>::seal(reg_block &block,
+                                              block_builder const &b,
+                                              std::uint32_t offset) {
+  // immediates still on the stack are written back at block exit
+  block.spills = b.spills();
+  block.min_slot = b.min_slot;
+  block.max_slot = b.max_slot;
+  block.delta = b.depth;
+  block.offset = offset;
+  block.next_offset = b.offset;
+  block.update_ip = b.update_ip;
+  block.dynamic = b.dynamic;
+  block.trap = b.trap;
+}
+
+template <typename Set, typename InstanceList>
+void reg_interpreter<Set, InstanceList>::translate_one(block_builder &b) {
+  static constexpr auto table = make_translate_table(
+      std::make_index_sequence<list::size_v<instr_set_desc_type>>());
+
+  // the instruction starts at its last opcode byte
+  std::size_t opcode{0};
+  auto status = this->decode(b.offset, opcode);
+  if (status != status_type::SUCCESS) {
+    b.trap = status;
+    b.end();
+  } else {
+    (this->*table[opcode])(b);
+  }
+}
+
+template <typename Set, typename InstanceList>
+void reg_interpreter<Set, InstanceList>::compile_trace(reg_block &head) {
+  LOG_INFO("reg_interpreter -> compile trace at " << head.offset);
+
+  reg_trace t;
+  block_builder b{t.instrs, head.offset};
+
+  for (std::size_t i = 0; i < m_trace_path.size(); ++i) {
+    b.offset = m_trace_path[i].first;
+    b.ended = false;
+    this->translate(b);
+
+    // only jumps and variable producers become guards
+    if (b.trap != status_type::SUCCESS || b.update_ip == b.dynamic) {
+      return;
+    }
+
+    auto next = i + 1 < m_trace_path.size() ? m_trace_path[i + 1].first
+                                            : head.offset;
+    reg_exit e{static_cast<std::uint32_t>(t.instrs.size()),
+               next,
+               b.offset,
+               b.depth,
+               b.dynamic,
+               b.spills()};
+
+    if (b.dynamic) {
+      // the recorded number of values is produced in place
+      e.expected = static_cast<std::uint32_t>(m_trace_path[i].second);
+      for (std::size_t k = 0; k < e.expected; ++k) {
+        b.push(b.produced);
+      }
+      if (b.offset != next) {
+        return;
+      }
+      b.dynamic = false;
+    } else {
+      b.update_ip = false;
+    }
+    t.exits.push_back(std::move(e));
+  }
+
+  if (t.exits.empty() || t.exits.back().dynamic) {
+    return;
+  }
+
+  t.min_slot = b.min_slot;
+  t.max_slot = b.max_slot;
+  head.trace = &(m_traces[head.offset] = std::move(t));
+}
+
+template <typename Set, typename InstanceList>
+template <typename I>
+void reg_interpreter<Set, InstanceList>::translate_instr(block_builder &b) {
+  constexpr auto size = instr_set_traits_type::template instr_length<I>;
+
+  if (b.offset + size > m_code_size) {
+    b.trap = status_type::CODE_OVERFLOW;
+    b.end();
+    return;
+  }
+
+  using args_type = details::reg_args_t<I>;
+
+  if constexpr (concept ::is_pipe_v<I>) {
+    using arg_type = list::front_t<args_type>;
+    constexpr bool from_stack =
+        reflect::is_specialization_of_v<details::stack_arg, arg_type>;
+
+    if constexpr (concept ::is_producer_v<I>) {
+      if constexpr (from_stack) {
+        // stack to stack, the value stays in place
+        b.push(b.pop());
+      } else {
+        // immediate folded in the operands of its readers
+        m_consts.emplace_back(
+            this->parse<typename arg_type::type>(b.offset + 1));
+        b.push(known_ref<typename arg_type::type>(
+            true, static_cast<std::int32_t>(m_consts.size() - 1)));
+      }
+    } else if constexpr (from_stack) {
+      b.pop();
+    }
+  } else {
+    reg_instr ri{&reg_interpreter::exec_instr<I>,
+                 b.offset,
+                 static_cast<std::uint32_t>(size),
+                 static_cast<std::uint32_t>(m_operands.size()),
+                 0,
+                 0,
+                 0,
+                 false,
+                 false};
+
+    // assign operands in consumption order
+    std::size_t code = b.offset + 1;
+    auto assign = [this, &b, &code](auto arg) {
+      using arg_type = decltype(arg);
+      if constexpr (reflect::is_specialization_of_v<details::code_arg,
+                                                    arg_type>) {
+        code += instr_set_traits_type::template type_size<
+            typename arg_type::type>;
+      } else if constexpr (reflect::is_specialization_of_v<details::stack_arg,
+                                                           arg_type>) {
+        m_operands.push_back(expect<typename arg_type::type>(b.pop()));
+      } else {
+        using counter_type = typename arg_type::counter_type;
+        auto count = this->parse<counter_type>(code);
+        code += instr_set_traits_type::template type_size<counter_type>;
+        for (std::size_t i = 0; i < count; ++i) {
+          m_operands.push_back(
+              expect<typename arg_type::type::value_type>(b.pop()));
+        }
+      }
+    };
+    std::apply([&assign](auto... args) { (assign(args), ...); },
+               list::rebind_t<std::tuple, args_type>{});
+
+    ri.count = static_cast<std::uint32_t>(m_operands.size()) - ri.first;
+    ri.base = b.depth;
+    ri.min_slot = b.min_slot;
+    ri.guarded = std::any_of(m_operands.begin() + ri.first, m_operands.end(),
+                             [](auto const &ref) { return !ref.typed; });
+    if constexpr (is_variant) {
+      if (!ri.guarded) {
+        // operands types are known, no need to wait for a first run
+        ri.exec = &reg_interpreter::exec_quick<I>;
+        ri.quick = true;
+      }
+    }
+    b.instrs.push_back(ri);
+
+    if constexpr (concept ::is_producer_v<I>) {
+      using datalist_type =
+          typename traits::producers_traits<I>::producer_datalist_type;
+      if constexpr (concept ::is_container_valid_v<
+                        std::decay_t<list::front_t<datalist_type>>>) {
+        // variable number of values, the block ends here
+        b.dynamic = true;
+        b.produced = known_ref<typename std::decay_t<
+            list::front_t<datalist_type>>::value_type>(false, 0);
+        b.end();
+      } else {
+        for (auto const &ref : produced_refs(datalist_type{})) {
+          b.push(ref);
+        }
+      }
+    }
+
+    if constexpr (concept ::is_ip_udpater_v<I>) {
+      b.update_ip = true;
+      b.end();
+    }
+  }
+
+  b.offset += static_cast<std::uint32_t>(size);
+}
+
+template <typename Set, typename InstanceList>
+void reg_interpreter<Set, InstanceList>::run() {
+  m_trace_head = nullptr;
+
+  for (std::uint32_t offset = 0; offset < m_code_size;) {
+    auto *b = this->block_for(offset);
+    if (!b) {
+      // a loop going through cold code is not traced
+      m_trace_head = nullptr;
+      offset = this->run_cold(offset);
+    } else if (b->trace) {
+      offset = this->run_trace(*b);
+    } else {
+      auto next = this->execute(*b);
+      this->profile(*b, next);
+      offset = next;
+    }
+  }
+}
+
+template <typename Set, typename InstanceList>
+std::uint32_t
+reg_interpreter<Set, InstanceList>::run_cold(std::uint32_t offset) {
+  static constexpr auto table = make_step_table(
+      std::make_index_sequence<list::size_v<instr_set_desc_type>>());
+
+  for (;;) {
+    std::size_t opcode{0};
+    auto status = this->decode(offset, opcode);
+    if (status == status_type::CODE_OVERFLOW) {
+      throw_mexcept("[-][mvm] bytecode overflow", status);
+    } else if (status != status_type::SUCCESS) {
+      throw_mexcept("[-][mvm] invalid instruction opcode", status);
+    }
+
+    if ((this->*table[opcode])(offset) || offset >= m_code_size) {
+      return offset;
+    }
+  }
+}
+
+template <typename Set, typename InstanceList>
+template <typename I>
+bool reg_interpreter<Set, InstanceList>::step_instr(std::uint32_t &offset) {
+  constexpr auto size = instr_set_traits_type::template instr_length<I>;
+
+  if (offset + size > m_code_size) {
+    throw_mexcept("[-][mvm] bytecode overflow", status_type::CODE_OVERFLOW);
+  }
+
+  using args_type = details::reg_args_t<I>;
+
+  if constexpr (concept ::is_pipe_v<I>) {
+    using arg_type = list::front_t<args_type>;
+    constexpr bool from_stack =
+        reflect::is_specialization_of_v<details::stack_arg, arg_type>;
+
+    if constexpr (from_stack) {
+      this->pop_slot();
+      if constexpr (concept ::is_producer_v<I>) {
+        // stack to stack, the value stays in place
+        ++m_depth;
+      }
+    } else if constexpr (concept ::is_producer_v<I>) {
+      if (m_slots.size() <= m_depth) {
+        m_slots.resize(m_depth + 1);
+      }
+      m_slots[m_depth++] =
+          value_type{this->parse<typename arg_type::type>(offset + 1)};
+    }
+  } else {
+    this->step_args<I>(offset, args_type{});
+
+    if constexpr (concept ::is_ip_udpater_v<I>) {
+      offset = this->ip_offset();
+      return true;
+    }
+    if constexpr (concept ::is_producer_v<I>) {
+      using datalist_type =
+          typename traits::producers_traits<I>::producer_datalist_type;
+      if constexpr (concept ::is_container_valid_v<
+                        std::decay_t<list::front_t<datalist_type>>>) {
+        offset += static_cast<std::uint32_t>(size);
+        return true;
+      }
+    }
+  }
+
+  offset += static_cast<std::uint32_t>(size);
+  return false;
+}
+
+template <typename Set, typename InstanceList>
+template <typename I, typename... Args>
+void reg_interpreter<Set, InstanceList>::step_args(std::uint32_t offset,
+                                                   list::mplist<Args...>) {
+  LOG_INFO("reg_interpreter -> process cold instruction "
+           << typestring::char_seq<typename I::name_type>::value);
+
+  constexpr auto size = instr_set_traits_type::template instr_length<I>;
+  auto last = offset + static_cast<std::uint32_t>(size) - 1;
+
+  // unused by instructions without arguments
+  [[maybe_unused]] std::size_t code = offset + 1;
+
+  // braced init list guarantees left to right consumption
+  std::tuple<typename Args::type...> args{this->take<Args>(code)...};
+
+  if constexpr (concept ::is_producer_v<I>) {
+    using datalist_type =
+        typename traits::producers_traits<I>::producer_datalist_type;
+    constexpr auto count = list::size_v<datalist_type>;
+
+    auto &&res = this->call<I>(last, std::move(args),
+                               std::index_sequence_for<Args...>{});
+    if (m_slots.size() < m_depth + count) {
+      m_slots.resize(m_depth + count);
+    }
+    this->write<datalist_type>(0, std::forward<decltype(res)>(res));
+
+    if constexpr (concept ::is_container_valid_v<
+                      std::decay_t<list::front_t<datalist_type>>>) {
+      m_depth += m_produced;
+    } else {
+      m_depth += count;
+    }
+  } else {
+    this->call<I>(last, std::move(args), std::index_sequence_for<Args...>{});
+  }
+}
+
+template <typename Set, typename InstanceList>
+template <typename Arg>
+typename Arg::type
+reg_interpreter<Set, InstanceList>::take(std::size_t &code) {
+  if constexpr (reflect::is_specialization_of_v<details::code_arg, Arg>) {
+    auto val = this->parse<typename Arg::type>(code);
+    code += instr_set_traits_type::template type_size<typename Arg::type>;
+    return val;
+  } else if constexpr (reflect::is_specialization_of_v<details::stack_arg,
+                                                       Arg>) {
+    return get<typename Arg::type, true>(std::move(this->pop_slot()));
+  } else {
+    using counter_type = typename Arg::counter_type;
+    auto count = this->parse<counter_type>(code);
+    code += instr_set_traits_type::template type_size<counter_type>;
+
+    typename Arg::type iter;
+    for (std::size_t i = 0; i < count; ++i) {
+      iter.push_back(get<typename Arg::type::value_type, true>(
+          std::move(this->pop_slot())));
+    }
+    return iter;
+  }
+}
+
+template <typename Set, typename InstanceList>
+void reg_interpreter<Set, InstanceList>::profile(reg_block const &b,
+                                                 std::uint32_t next) {
+  if (m_trace_head) {
+    m_trace_path.emplace_back(b.offset, b.dynamic ? m_produced : 0);
+    if (next == m_trace_head->offset) {
+      this->compile_trace(*m_trace_head);
+      m_trace_head = nullptr;
+    } else if (next >= m_code_size ||
+               m_trace_path.size() == max_trace_blocks) {
+      m_trace_head = nullptr;
+    }
+  } else if (b.update_ip && next < b.next_offset) {
+    auto it = m_blocks.find(next);
+    if (it != m_blocks.end() && ++it->second.hits == m_tiers.trace) {
+      // hot backward jump target, record the loop from there
+      m_trace_head = &it->second;
+      m_trace_path.clear();
+    }
+  }
+}
+
+template <typename Set, typename InstanceList>
+std::uint32_t reg_interpreter<Set, InstanceList>::run_trace(reg_block &head) {
+  auto &t = *head.trace;
+
+  for (;;) {
+    auto depth = static_cast<std::ptrdiff_t>(m_depth);
+    if (depth + t.min_slot < 0) {
+      // the block reports the error
+      return this->execute(head);
+    }
+    if (m_slots.size() < static_cast<std::size_t>(depth + t.max_slot)) {
+      m_slots.resize(static_cast<std::size_t>(depth + t.max_slot));
+    }
+
+    std::size_t i{0};
+    for (auto const &e : t.exits) {
+      for (; i < e.end; ++i) {
+        auto &ri = t.instrs[i];
+        ri.exec(*this, ri);
+      }
+
+      if (e.dynamic) {
+        if (m_produced != e.expected) {
+          this->leave(e, depth, m_produced);
+          return e.next_offset;
+        }
+      } else if (this->ip_offset() != e.expected) {
+        this->leave(e, depth, 0);
+        return this->ip_offset();
+      }
+    }
+
+    // back to the loop head
+    this->leave(t.exits.back(), depth, 0);
+  }
+}
+
+template <typename Set, typename InstanceList>
+std::uint32_t reg_interpreter<Set, InstanceList>::execute(reg_block &b) {
+  auto depth = static_cast<std::ptrdiff_t>(m_depth);
+
+  if (MVM_LIKELY(depth + b.min_slot >= 0)) {
+    if (m_slots.size() < static_cast<std::size_t>(depth + b.max_slot)) {
+      m_slots.resize(static_cast<std::size_t>(depth + b.max_slot));
+    }
+    for (auto &ri : b.instrs) {
+      ri.exec(*this, ri);
+    }
+  } else {
+    // stop at the instruction reading an empty stack
+    if (m_slots.size() < static_cast<std::size_t>(depth + b.max_slot)) {
+      m_slots.resize(static_cast<std::size_t>(depth + b.max_slot));
+    }
+    for (auto &ri : b.instrs) {
+      if (depth + ri.min_slot < 0) {
+        break;
+      }
+      ri.exec(*this, ri);
+    }
+    throw_mexcept("[-][mvm] try to pop from empty stack",
+                  status_type::POP_EMPTY_STACK);
+  }
+
+  for (auto const &s : b.spills) {
+    this->slot(s.first) = m_consts[s.second];
+  }
+
+  m_depth = static_cast<std::size_t>(depth + b.delta) +
+            (b.dynamic ? m_produced : 0);
+
+  if (MVM_UNLIKELY(b.trap != status_type::SUCCESS)) {
+    throw_mexcept("[-][mvm] invalid translated instruction", b.trap);
+  }
+
+  return b.update_ip ? this->ip_offset() : b.next_offset;
+}
+
+template <typename Set, typename InstanceList>
+template <typename I, bool Checked, typename... Args>
+void reg_interpreter<Set, InstanceList>::exec_args(reg_instr const &ri,
+                                                   list::mplist<Args...>) {
+  LOG_INFO("reg_interpreter -> process instruction "
+           << typestring::char_seq<typename I::name_type>::value);
+
+  // unused by instructions without arguments
+  [[maybe_unused]] std::uint32_t operand = ri.first;
+  [[maybe_unused]] std::size_t code = ri.offset + 1;
+
+  // braced init list guarantees left to right consumption
+  std::tuple<typename Args::type...> args{
+      this->fetch<Args, Checked>(operand, code)...};
+
+  if constexpr (concept ::is_producer_v<I>) {
+    this->write<typename traits::producers_traits<I>::producer_datalist_type>(
+        ri.base, this->call<I>(ri.offset + ri.size - 1, std::move(args),
+                               std::index_sequence_for<Args...>{}));
+  } else {
+    this->call<I>(ri.offset + ri.size - 1, std::move(args),
+                  std::index_sequence_for<Args...>{});
+  }
+}
+
+template <typename Set, typename InstanceList>
+template <typename I, typename Tuple, std::size_t... Is>
+auto reg_interpreter<Set, InstanceList>::call(std::uint32_t last,
+                                              Tuple &&args,
+                                              std::index_sequence<Is...>) {
+  // handlers receive their arguments in reverse consumption order
+  constexpr auto n = sizeof...(Is);
+  if constexpr (concept ::is_ip_udpater_v<I>) {
+    static_cast<ip &>(m_rebased_ip) = last;
+    return I::apply(m_iset, m_rebased_ip,
+                    std::get<n - 1 - Is>(std::forward<Tuple>(args))...);
+  } else {
+    return I::apply(m_iset, std::get<n - 1 - Is>(std::forward<Tuple>(args))...);
+  }
+}
+
+template <typename Set, typename InstanceList>
+template <typename Arg, bool Checked>
+typename Arg::type
+reg_interpreter<Set, InstanceList>::fetch(std::uint32_t &operand,
+                                          std::size_t &code) {
+  if constexpr (reflect::is_specialization_of_v<details::code_arg, Arg>) {
+    auto val = this->parse<typename Arg::type>(code);
+    code += instr_set_traits_type::template type_size<typename Arg::type>;
+    return val;
+  } else if constexpr (reflect::is_specialization_of_v<details::stack_arg,
+                                                       Arg>) {
+    return this->read<typename Arg::type, Checked>(m_operands[operand++]);
+  } else {
+    using counter_type = typename Arg::counter_type;
+    auto count = this->parse<counter_type>(code);
+    code += instr_set_traits_type::template type_size<counter_type>;
+
+    typename Arg::type iter;
+    for (std::size_t i = 0; i < count; ++i) {
+      iter.push_back(this->read<typename Arg::type::value_type, Checked>(
+          m_operands[operand++]));
+    }
+    return iter;
+  }
+}
+
+template <typename Set, typename InstanceList>
+template <typename DataList, typename R>
+void reg_interpreter<Set, InstanceList>::write(std::int32_t base, R &&res) {
+  if constexpr (concept ::is_tuple_v<std::decay_t<R>>) {
+    std::apply(
+        [this, base](auto &&... vals) {
+          std::int32_t i = base;
+          ((this->slot(i++) = value_type{std::forward<decltype(vals)>(vals)}),
+           ...);
+        },
+        std::forward<R>(res));
+  } else if constexpr (concept ::is_container_valid_v<std::decay_t<R>>) {
+    auto first = static_cast<std::size_t>(
+        static_cast<std::ptrdiff_t>(m_depth) + base);
+    if (m_slots.size() < first + res.size()) {
+      m_slots.resize(first + res.size());
+    }
+    for (auto &sub : res) {
+      m_slots[first++] = value_type{std::move(sub)};
+    }
+    m_produced = res.size();
+  } else {
+    this->slot(base) = value_type{std::forward<R>(res)};
+  }
+}
+} // namespace mvm
@@ -0,0 +1,78 @@
+// Copyright 2019 Ken Avolic <kenavolic@none.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include "mvm/except.h"
+#include "mvm/trace.h"
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+namespace mvm {
+
+///
+/// @brief Fixed size register file
+///
+/// Default instance of the meta_register_file concept. Registers with an
+/// index known at compile time are accessed without bound check.
+///
+template <std::size_t N, typename T> class register_file {
+  std::array<T, N> m_regs{};
+
+public:
+  using value_type = T;
+
+  static constexpr std::size_t size = N;
+
+  ///
+  /// @brief Read register I
+  ///
+  template <std::size_t I> T const &get() const {
+    static_assert(I < N, "[-][mvm] register index out of range");
+    return std::get<I>(m_regs);
+  }
+
+  ///
+  /// @brief Read register i
+  ///
+  T const &get(std::size_t i) const {
+    if (MVM_UNLIKELY(i >= N)) {
+      throw_mexcept("[-][mvm] invalid register", status_type::INVALID_REGISTER);
+    }
+    return m_regs[i];
+  }
+
+  ///
+  /// @brief Write register I
+  ///
+  template <std::size_t I, typename U> void set(U &&val) {
+    static_assert(I < N, "[-][mvm] register index out of range");
+    LOG_INFO("register_file -> set r" << I << " = " << val);
+    std::get<I>(m_regs) = std::forward<U>(val);
+  }
+
+  ///
+  /// @brief Write register i
+  ///
+  template <typename U> void set(std::size_t i, U &&val) {
+    if (MVM_UNLIKELY(i >= N)) {
+      throw_mexcept("[-][mvm] invalid register", status_type::INVALID_REGISTER);
+    }
+    LOG_INFO("register_file -> set r" << i << " = " << val);
+    m_regs[i] = std::forward<U>(val);
+  }
+};
+} // namespace mvm
@@ -27,6 +27,10 @@ enum class status_type : uint16_t {
   CODE_OVERFLOW,
   POP_EMPTY_STACK,
   INTERNAL_ERROR,
-  UNKNOWN_ERROR
+  UNKNOWN_ERROR,
+  PUSH_FULL_STACK,
+  INVALID_REGISTER,
+  IO_ERROR,
+  BAD_VALUE_TYPE
 };
 }
\ No newline at end of file
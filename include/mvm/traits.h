@@ -14,15 +14,219 @@
 
 #pragma once
 
+#include "mvm/concept.h"
 #include "mvm/meta.h"
+#include "mvm/opcode_profile.h"
 
+#include <array>
+#include <cstdint>
+#include <tuple>
+#include <memory>
+#include <string_view>
 #include <type_traits>
 #include <variant>
 #include <vector>
 
 namespace mvm {
+namespace traits {
+
+///
+/// @brief Instruction properties stored in instr_set_traits::instr_flags
+///
+namespace instr_flag {
+// instruction handler updates ip
+inline constexpr std::uint8_t update_ip = 1 << 0;
+// number of values popped from the value stack is read from the bytecode
+inline constexpr std::uint8_t iterable = 1 << 1;
+// number of values pushed to the value stack is known at runtime only
+inline constexpr std::uint8_t variable_push = 1 << 2;
+// instruction is a pipe, no handler is called
+inline constexpr std::uint8_t pipe = 1 << 3;
+// instruction has no side effect besides its stack effect
+inline constexpr std::uint8_t pure = 1 << 4;
+// handler operands are read in place and replaced by its result
+inline constexpr std::uint8_t in_place = 1 << 5;
+} // namespace instr_flag
+} // namespace traits
+
 namespace details {
 // Hide traits intermediate computation in details ns
+
+// effect of a consumer or a producer on the Meta instance
+template <template <typename> typename Meta, typename MetaTie>
+struct stack_effect {
+  static constexpr std::size_t count = 0;
+  static constexpr bool variable = false;
+};
+
+template <template <typename> typename Meta, typename... Ts>
+struct stack_effect<Meta, meta_tie<Meta, Ts...>> {
+  // containers are pushed element by element
+  static constexpr std::size_t count =
+      (std::size_t{0} + ... +
+       !concept ::is_container_valid_v<std::decay_t<Ts>>);
+  static constexpr bool variable =
+      (concept ::is_container_valid_v<std::decay_t<Ts>> || ... || false);
+};
+
+template <template <typename> typename Meta, typename Iterable,
+          typename Counter>
+struct stack_effect<Meta, iterable_consumer<Meta, Iterable, Counter>> {
+  static constexpr std::size_t count = 0;
+  static constexpr bool variable = true;
+};
+
+// effect of a consumer or producer list on the Meta instance
+template <template <typename> typename Meta, typename MetaTieList>
+struct stack_effects;
+
+template <template <typename> typename Meta,
+          template <typename...> typename T, typename... MetaTie>
+struct stack_effects<Meta, T<MetaTie...>> {
+  static constexpr std::size_t count =
+      (std::size_t{0} + ... + stack_effect<Meta, MetaTie>::count);
+  static constexpr bool variable =
+      (stack_effect<Meta, MetaTie>::variable || ... || false);
+
+  static_assert(count <= 0xFF,
+                "[-][mvm] instruction metadata out of table range");
+};
+
+// encoded size of an instruction with a single opcode byte
+template <typename Set, typename CodeTypes> struct instr_length;
+
+template <typename Set, typename... Ts>
+struct instr_length<Set, list::mplist<Ts...>> {
+  static constexpr std::size_t value =
+      (std::size_t{1} + ... + Set::template code_value_repr<Ts>::size);
+};
+
+// properties of a single instruction
+template <typename Set, typename I> struct instr_meta {
+  template <template <typename> typename Meta>
+  using pops_of = stack_effects<Meta, typename I::consumers_type>;
+  template <template <typename> typename Meta>
+  using pushes_of = stack_effects<Meta, typename I::producers_type>;
+
+  using pops_type = pops_of<meta_value_stack>;
+  using pushes_type = pushes_of<meta_value_stack>;
+
+  static constexpr std::size_t length =
+      instr_length<Set, typename I::bytecode_type>::value;
+
+  // handlers are opaque, only pipes are known to be side effect free
+  static constexpr std::uint8_t flags = static_cast<std::uint8_t>(
+      (I::doUpdateIp ? traits::instr_flag::update_ip : 0) |
+      (pops_type::variable ? traits::instr_flag::iterable : 0) |
+      (pushes_type::variable ? traits::instr_flag::variable_push : 0) |
+      (I::isPipe ? traits::instr_flag::pipe | traits::instr_flag::pure : 0) |
+      (I::isInPlace ? traits::instr_flag::in_place : 0));
+
+  static_assert(length <= 0xFFFF,
+                "[-][mvm] instruction metadata out of table range");
+};
+
+// per opcode tables of instruction properties
+template <typename Set, std::size_t ShortCount, typename I>
+struct instr_meta_aggregator;
+
+template <typename Set, std::size_t ShortCount, std::size_t... Is>
+struct instr_meta_aggregator<Set, ShortCount, std::index_sequence<Is...>> {
+  template <std::size_t N>
+  using meta_type = instr_meta<Set, list::at_t<N, typename Set::instr_table>>;
+
+  // extended opcodes are preceded by the escape byte
+  static constexpr std::array<std::uint16_t, sizeof...(Is)> lengths = {
+      static_cast<std::uint16_t>(meta_type<Is>::length +
+                                 (Is < ShortCount ? 0 : 1))...};
+  template <template <typename> typename Meta>
+  static constexpr std::array<std::uint8_t, sizeof...(Is)> pops_of = {
+      static_cast<std::uint8_t>(
+          meta_type<Is>::template pops_of<Meta>::count)...};
+  template <template <typename> typename Meta>
+  static constexpr std::array<std::uint8_t, sizeof...(Is)> pushes_of = {
+      static_cast<std::uint8_t>(
+          meta_type<Is>::template pushes_of<Meta>::count)...};
+  static constexpr std::array<std::uint8_t, sizeof...(Is)> flags = {
+      meta_type<Is>::flags...};
+};
+
+template <typename Set, typename = void>
+struct has_opcode_counts : std::false_type {};
+
+template <typename Set>
+struct has_opcode_counts<
+    Set, std::void_t<decltype(traits::opcode_counts<Set>::value)>>
+    : std::true_type {};
+
+// instruction hotness from a compile time opcode profile, every
+// instruction is hot without profile
+template <typename Set, std::size_t N, bool = has_opcode_counts<Set>::value>
+struct instr_hotness {
+  static constexpr auto order = [] {
+    std::array<std::uint16_t, N> res{};
+    for (std::size_t i = 0; i < N; ++i) {
+      res[i] = static_cast<std::uint16_t>(i);
+    }
+    return res;
+  }();
+
+  static constexpr auto hot = [] {
+    std::array<bool, N> res{};
+    for (auto &h : res) {
+      h = true;
+    }
+    return res;
+  }();
+};
+
+template <typename Set, std::size_t N> struct instr_hotness<Set, N, true> {
+  static constexpr auto counts = traits::opcode_counts<Set>::value;
+
+  static_assert(counts.size() == N,
+                "[-][mvm] opcode profile does not match the instruction set");
+
+  // instruction indexes by decreasing execution count
+  static constexpr auto order = [] {
+    std::array<std::uint16_t, N> res{};
+    for (std::size_t i = 0; i < N; ++i) {
+      auto j = i;
+      for (; j > 0 && counts[res[j - 1]] < counts[i]; --j) {
+        res[j] = res[j - 1];
+      }
+      res[j] = static_cast<std::uint16_t>(i);
+    }
+    return res;
+  }();
+
+  // hottest instructions covering 99% of the profiled executions, every
+  // instruction is hot if the profile did not run anything
+  static constexpr auto hot = [] {
+    std::uint64_t total{0};
+    for (auto c : counts) {
+      total += c;
+    }
+
+    std::array<bool, N> res{};
+    if (!total) {
+      for (auto &h : res) {
+        h = true;
+      }
+      return res;
+    }
+
+    std::uint64_t covered{0};
+    for (std::size_t i = 0; i < N && counts[order[i]] != 0; ++i) {
+      res[order[i]] = true;
+      covered += counts[order[i]];
+      if (covered >= total - total / 100) {
+        break;
+      }
+    }
+    return res;
+  }();
+};
+
 template <typename Set> struct instr_set_traits_impl {
   using set_type = Set;
   using instr_set_desc_type = typename set_type::instr_table;
@@ -37,13 +241,69 @@ template <typename Set> struct instr_set_traits_impl {
   static constexpr std::size_t instr_set_size =
       list::size_v<instr_set_desc_type>;
 
+  // Sets bigger than 256 instructions encode the first 255 ones on a
+  // single byte and the others on two bytes, after an escape byte
+  static constexpr bool is_extended = instr_set_size > 256;
+  static constexpr std::size_t short_opcode_count =
+      is_extended ? 255 : instr_set_size;
+
   // Map used to make assembler impl easier
   static constexpr auto instr_names =
       names_aggregator<instr_set_desc_type,
                        std::make_index_sequence<instr_set_size>>::value;
 
-  static_assert(instr_set_size <= 256,
-                "[-][mvm] max instruction set size (256) exceeded");
+  // Opcode indexes sorted by instruction name, equal names keep the
+  // opcode order
+  static constexpr auto name_order = [] {
+    std::array<std::uint16_t, instr_set_size> res{};
+    for (std::size_t i = 0; i < instr_set_size; ++i) {
+      std::size_t j = i;
+      for (; j > 0 && std::string_view{instr_names[i]} <
+                          std::string_view{instr_names[res[j - 1]]};
+           --j) {
+        res[j] = res[j - 1];
+      }
+      res[j] = static_cast<std::uint16_t>(i);
+    }
+    return res;
+  }();
+
+  // Instruction names in name_order
+  static constexpr auto sorted_names = [] {
+    std::array<std::string_view, instr_set_size> res{};
+    for (std::size_t i = 0; i < instr_set_size; ++i) {
+      res[i] = instr_names[name_order[i]];
+    }
+    return res;
+  }();
+
+  // Per opcode metadata tables
+  using instr_meta_type =
+      instr_meta_aggregator<Set, short_opcode_count,
+                            std::make_index_sequence<instr_set_size>>;
+
+  using instr_hotness_type = instr_hotness<Set, instr_set_size>;
+
+  // an instruction type may appear at several indexes
+  template <typename I, std::size_t... Is>
+  static constexpr bool is_hot(std::index_sequence<Is...>) {
+    return ((std::is_same_v<I, list::at_t<Is, instr_set_desc_type>> &&
+             instr_hotness_type::hot[Is]) ||
+            ...);
+  }
+
+  static_assert(instr_set_size <= 255 + 256,
+                "[-][mvm] max instruction set size (511) exceeded");
+};
+
+// build value stack arenas sharing the stack allocator
+template <typename Arena> struct make_arena;
+
+template <typename... Boxes> struct make_arena<std::tuple<Boxes...>> {
+  template <typename Alloc> static auto apply(Alloc const &alloc) {
+    return std::tuple<Boxes...>{
+        Boxes(typename Boxes::allocator_type(alloc))...};
+  }
 };
 
 } // namespace details
@@ -66,6 +326,95 @@ template <typename Set> struct instr_set_traits {
   static constexpr auto instr_names =
       details::instr_set_traits_impl<Set>::instr_names;
 
+  static constexpr std::size_t instr_set_size =
+      details::instr_set_traits_impl<Set>::instr_set_size;
+
+  ///
+  /// @brief Binary search of an instruction by name
+  ///
+  /// @return the instruction index or instr_set_size if not found
+  ///
+  static constexpr std::size_t instr_index(std::string_view name) noexcept {
+    using impl_type = details::instr_set_traits_impl<Set>;
+
+    std::size_t first{0};
+    std::size_t count{instr_set_size};
+    while (count > 0) {
+      auto step = count / 2;
+      if (impl_type::sorted_names[first + step] < name) {
+        first += step + 1;
+        count -= step + 1;
+      } else {
+        count = step;
+      }
+    }
+
+    if (first < instr_set_size && impl_type::sorted_names[first] == name) {
+      return impl_type::name_order[first];
+    }
+    return instr_set_size;
+  }
+
+  // Set uses two byte opcodes for instructions past short_opcode_count
+  static constexpr bool is_extended =
+      details::instr_set_traits_impl<Set>::is_extended;
+
+  // Number of instructions encoded with a single opcode byte
+  static constexpr std::size_t short_opcode_count =
+      details::instr_set_traits_impl<Set>::short_opcode_count;
+
+  // First byte of two byte opcodes, the second byte is the instruction
+  // index minus short_opcode_count
+  static constexpr std::uint8_t opcode_escape = 0xFF;
+
+  // Encoded length of each instruction, opcode included
+  static constexpr auto instr_lengths =
+      details::instr_set_traits_impl<Set>::instr_meta_type::lengths;
+
+  // Fixed number of values read from the Meta instance (value stack,
+  // register file or bytecode) by each instruction
+  template <template <typename> typename Meta>
+  static constexpr auto instr_pops_of = details::instr_set_traits_impl<
+      Set>::instr_meta_type::template pops_of<Meta>;
+
+  // Fixed number of values written to the Meta instance by each instruction
+  template <template <typename> typename Meta>
+  static constexpr auto instr_pushes_of = details::instr_set_traits_impl<
+      Set>::instr_meta_type::template pushes_of<Meta>;
+
+  // Fixed number of values popped from the value stack by each instruction
+  static constexpr auto instr_pops = instr_pops_of<meta_value_stack>;
+
+  // Fixed number of values pushed to the value stack by each instruction
+  static constexpr auto instr_pushes = instr_pushes_of<meta_value_stack>;
+
+  // Combination of instr_flag values for each instruction
+  static constexpr auto instr_flags =
+      details::instr_set_traits_impl<Set>::instr_meta_type::flags;
+
+  // Set built with an opcode profile specializing opcode_counts
+  static constexpr bool has_opcode_profile =
+      details::has_opcode_counts<Set>::value;
+
+  // Instruction indexes by decreasing profiled execution count
+  static constexpr auto instr_hot_order =
+      details::instr_set_traits_impl<Set>::instr_hotness_type::order;
+
+  // Instructions whose handlers belong to the hot code, all of them
+  // without opcode profile
+  static constexpr auto instr_hot =
+      details::instr_set_traits_impl<Set>::instr_hotness_type::hot;
+
+  template <typename I>
+  static constexpr bool is_hot_instr =
+      details::instr_set_traits_impl<Set>::template is_hot<I>(
+          std::make_index_sequence<instr_set_size>());
+
+  // Encoded length of an instruction from its last opcode byte
+  template <typename I>
+  static constexpr std::size_t instr_length =
+      details::instr_meta<Set, I>::length;
+
   template <typename T>
   static constexpr auto type_size = set_type::template code_value_repr<T>::size;
 
@@ -74,25 +423,151 @@ template <typename Set> struct instr_set_traits {
       typename set_type::template code_value_repr<T>::endian_type;
 };
 
+///
+/// @brief handle stored in a value stack slot for an out-of-line value
+///
+template <typename T> struct boxed_handle { std::size_t index; };
+
+// values bigger than this size are stored out of the slots of a
+// multiple type value stack so that scalar slots stay small
+inline constexpr std::size_t max_inline_value_size = 2 * sizeof(void *);
+
+template <typename T>
+struct is_inline_value
+    : std::bool_constant<(sizeof(T) <= max_inline_value_size)> {};
+
 ///
 /// @brief traits class for value_stack
 ///
-template <typename TypeList, std::size_t = list::size_v<TypeList>>
+/// Large values are moved to a per type arena and the slot only keeps
+/// a handle to it. As the stack is lifo, a handle always refers to the
+/// last value of its arena.
+///
+template <typename TypeList,
+          template <typename> typename Allocator = std::allocator,
+          std::size_t = list::size_v<TypeList>>
 struct value_stack_traits {
+  template <typename T> using boxed_arena = std::vector<T, Allocator<T>>;
+
+  using inline_types = list::filter_t<is_inline_value, true, TypeList>;
+  using boxed_types = list::filter_t<is_inline_value, false, TypeList>;
+
+  using value_type = list::rebind_t<
+      std::variant,
+      list::concat_t<inline_types, list::map_t<boxed_handle, boxed_types>>>;
+  using allocator_type = Allocator<value_type>;
+  using stack_type = std::vector<value_type, allocator_type>;
+  using arena_type =
+      list::rebind_t<std::tuple, list::map_t<boxed_arena, boxed_types>>;
+
+  static arena_type make_arena(allocator_type const &alloc) {
+    return details::make_arena<arena_type>::apply(alloc);
+  }
+
+  template <typename T>
+  static value_type make_val(T &&val, arena_type &arena) {
+    using type = std::decay_t<T>;
+
+    if constexpr (is_inline_value<type>::value) {
+      return value_type{std::forward<T>(val)};
+    } else {
+      auto &boxes = std::get<boxed_arena<type>>(arena);
+      boxes.push_back(std::forward<T>(val));
+      return value_type{boxed_handle<type>{boxes.size() - 1}};
+    }
+  }
+
+  template <typename T> static bool holds(value_type const &val) noexcept {
+    if constexpr (is_inline_value<T>::value) {
+      return std::holds_alternative<T>(val);
+    } else {
+      return std::holds_alternative<boxed_handle<T>>(val);
+    }
+  }
+
+  template <typename T> static T const &peek_val(value_type const &val) {
+    static_assert(is_inline_value<T>::value,
+                  "[-][mvm] only inline values can be read in place");
+    return std::get<T>(val);
+  }
+
+  template <typename T> static T get_val(value_type &&val, arena_type &arena) {
+    if constexpr (is_inline_value<T>::value) {
+      return std::get<T>(std::move(val));
+    } else {
+      auto &boxes = std::get<boxed_arena<T>>(arena);
+      T res = std::move(boxes[std::get<boxed_handle<T>>(val).index]);
+      boxes.pop_back();
+      return res;
+    }
+  }
+};
+
+template <typename TypeList, template <typename> typename Allocator>
+struct value_stack_traits<TypeList, Allocator, 1> {
+  using value_type = list::front_t<TypeList>;
+  using allocator_type = Allocator<value_type>;
+  using stack_type = std::vector<value_type, allocator_type>;
+  using arena_type = std::tuple<>;
+
+  static arena_type make_arena(allocator_type const &) { return {}; }
+
+  template <typename T> static value_type make_val(T &&val, arena_type &) {
+    return value_type{std::forward<T>(val)};
+  }
+
+  template <typename T> static bool holds(value_type const &) noexcept {
+    return true;
+  }
 
+  template <typename T>
+  static value_type const &peek_val(value_type const &val) {
+    return val;
+  }
+
+  template <typename T> static T get_val(value_type &&val, arena_type &) {
+    return std::move(val);
+  }
+};
+
+///
+/// @brief traits class for stacks whose slots never move
+///
+/// Values are stored in the slots whatever their size, there is no
+/// boxing arena.
+///
+template <typename TypeList, std::size_t = list::size_v<TypeList>>
+struct unboxed_stack_traits {
   using value_type = list::rebind_t<std::variant, TypeList>;
-  using stack_type = std::vector<value_type>;
 
-  template <typename T> static auto get_val(value_type &&val) {
-    return std::get<T>(std::forward<value_type>(val));
+  template <typename T> static bool holds(value_type const &val) noexcept {
+    return std::holds_alternative<T>(val);
+  }
+
+  template <typename T> static T const &peek_val(value_type const &val) {
+    return std::get<T>(val);
+  }
+
+  template <typename T> static T get_val(value_type &&val) {
+    return std::get<T>(std::move(val));
   }
 };
 
-template <typename TypeList> struct value_stack_traits<TypeList, 1> {
+template <typename TypeList> struct unboxed_stack_traits<TypeList, 1> {
   using value_type = list::front_t<TypeList>;
-  using stack_type = std::vector<value_type>;
 
-  template <typename T> static auto get_val(T val) { return val; }
+  template <typename T> static bool holds(value_type const &) noexcept {
+    return true;
+  }
+
+  template <typename T>
+  static value_type const &peek_val(value_type const &val) {
+    return val;
+  }
+
+  template <typename T> static T get_val(value_type &&val) {
+    return std::move(val);
+  }
 };
 
 ///
@@ -100,9 +575,21 @@ template <typename TypeList> struct value_stack_traits<TypeList, 1> {
 ///
 template <typename I> struct producers_traits {
   using producers_type = typename I::producers_type;
-  static_assert(list::size_v<producers_type> == 1,
-                "[-][mvm] only single producer handled now");
 
+  static constexpr std::size_t producer_count = list::size_v<producers_type>;
+
+  // position of the first value of each producer in the handler result
+  template <std::size_t N> static constexpr std::size_t result_offset() {
+    if constexpr (N == 0) {
+      return 0;
+    } else {
+      using previous_type = list::at_t<N - 1, producers_type>;
+      return result_offset<N - 1>() +
+             list::size_v<typename previous_type::meta_data_type>;
+    }
+  }
+
+  // first producer, the only one of single producer instructions
   using producer_type = list::front_t<producers_type>;
   using producer_datalist_type = typename producer_type::meta_data_type;
 
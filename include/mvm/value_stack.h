@@ -18,38 +18,99 @@
 #include "mvm/trace.h"
 #include "mvm/traits.h"
 
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
 namespace mvm {
 
 ///
 /// @brief Heterogenerous value stack
 ///
-template <typename TypeList> class value_stack {
-  using value_stack_traits = traits::value_stack_traits<TypeList>;
+template <typename TypeList,
+          template <typename> typename Allocator = std::allocator>
+class value_stack {
+  using value_stack_traits = traits::value_stack_traits<TypeList, Allocator>;
   using value_type = typename value_stack_traits::value_type;
   using stack_type = typename value_stack_traits::stack_type;
+  using arena_type = typename value_stack_traits::arena_type;
   stack_type m_stack;
+  arena_type m_arena;
 
 public:
+  using allocator_type = typename value_stack_traits::allocator_type;
+
+  value_stack() = default;
+
+  explicit value_stack(allocator_type const &alloc)
+      : m_stack(alloc), m_arena{value_stack_traits::make_arena(alloc)} {}
+
   ///
   /// @brief Push data to the stack
   ///
   template <typename T> void push(T &&val) {
     LOG_INFO("value_stack -> push " << val << " on stack[" << this << "]");
-    m_stack.push_back(value_type{std::forward<T>(val)});
+    m_stack.push_back(
+        value_stack_traits::make_val(std::forward<T>(val), m_arena));
   }
 
+  ///
+  /// @brief Reserve slots for n values
+  ///
+  void reserve(std::size_t n) { m_stack.reserve(n); }
+
   ///
   /// @brief Pop data from the stack
   ///
   template <typename T> T pop() {
-    if (m_stack.empty()) {
-      throw mexcept("[-][mvm] try to pop from empty stack",
+    if (MVM_UNLIKELY(m_stack.empty())) {
+      throw_mexcept("[-][mvm] try to pop from empty stack",
                     status_type::POP_EMPTY_STACK);
     }
-    auto val = m_stack.back();
+    // a type mismatch leaves the stack and its arenas untouched
+    if (MVM_UNLIKELY(!value_stack_traits::template holds<T>(m_stack.back()))) {
+      throw_mexcept("[-][mvm] try to pop a value of another type",
+                    status_type::BAD_VALUE_TYPE);
+    }
+    auto val = std::move(m_stack.back());
     m_stack.pop_back();
     LOG_INFO("value_stack -> pop from stack[" << this << "]");
-    return value_stack_traits::template get_val<T>(std::move(val));
+    return value_stack_traits::template get_val<T>(std::move(val), m_arena);
+  }
+
+  ///
+  /// @brief Read the value at depth i without popping it, 0 being the top
+  ///
+  template <typename T> T const &peek(std::size_t i) const {
+    if (MVM_UNLIKELY(i >= m_stack.size())) {
+      throw_mexcept("[-][mvm] try to peek past the bottom of the stack",
+                    status_type::POP_EMPTY_STACK);
+    }
+    auto const &val = m_stack[m_stack.size() - 1 - i];
+    if (MVM_UNLIKELY(!value_stack_traits::template holds<T>(val))) {
+      throw_mexcept("[-][mvm] try to peek a value of another type",
+                    status_type::BAD_VALUE_TYPE);
+    }
+    return value_stack_traits::template peek_val<T>(val);
+  }
+
+  ///
+  /// @brief Replace the n top values by a single one
+  ///
+  template <typename T> void replace(std::size_t n, T &&val) {
+    if (MVM_UNLIKELY(n == 0 || n > m_stack.size())) {
+      throw_mexcept("[-][mvm] try to pop from empty stack",
+                    status_type::POP_EMPTY_STACK);
+    }
+    m_stack.erase(m_stack.end() - static_cast<std::ptrdiff_t>(n - 1),
+                  m_stack.end());
+    m_stack.back() =
+        value_stack_traits::make_val(std::forward<T>(val), m_arena);
   }
 };
+
+namespace pmr {
+template <typename TypeList>
+using value_stack = mvm::value_stack<TypeList, std::pmr::polymorphic_allocator>;
+} // namespace pmr
 } // namespace mvm
\ No newline at end of file
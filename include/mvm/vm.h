@@ -20,9 +20,13 @@
 #include "mvm/except.h"
 #include "mvm/instr_set.h"
 #include "mvm/interpreter.h"
+#include "mvm/reg_interpreter.h"
 #include "mvm/status.h"
 #include "mvm/value_stack.h"
 
+#include <memory_resource>
+#include <string_view>
+
 namespace mvm {
 
 ///
@@ -37,23 +41,82 @@ class vm {
   using instr_set_type = Set;
   using bytecode_serializer_type = instance_of_t<InstanceList, meta_bytecode>;
   using interpreter_type = interpreter<Set, InstanceList>;
+  using reg_interpreter_type = reg_interpreter<Set, InstanceList>;
   using assembler_type = assembler<Set, bytecode_serializer_type>;
   using disassembler_type = disassembler<Set, bytecode_serializer_type>;
 
   interpreter_type m_interpreter;
+  reg_interpreter_type m_reg_interpreter;
   assembler_type m_assembler;
   disassembler_type m_disassembler;
 
 public:
-  vm(instr_set_type &iset) : m_interpreter{iset} {}
+  using stack_profile_type = typename interpreter_type::stack_profile_type;
+  using opcode_profile_type = typename interpreter_type::opcode_profile_type;
+
+  vm(instr_set_type &iset) : m_interpreter{iset}, m_reg_interpreter{iset} {}
+
+  ///
+  /// @brief Build vm with interpreter instances allocating from a memory
+  /// resource
+  ///
+  vm(instr_set_type &iset, std::pmr::memory_resource *res)
+      : m_interpreter{iset, res}, m_reg_interpreter{iset} {}
 
   ///
   /// @brief Interpret code chunk
   ///
-  auto interpret(prog_chunk const &c) {
+  template <typename Alloc> auto interpret(basic_prog_chunk<Alloc> const &c) {
     return translate([&]() { m_interpreter.interpret(c); });
   }
 
+  ///
+  /// @brief Interpret code chunk and record its stack usage
+  ///
+  /// Profiled stacks are sized from the profile of a previous run of the
+  /// same chunk and the profile is updated with the new max depths.
+  ///
+  template <typename Alloc>
+  auto interpret(basic_prog_chunk<Alloc> const &c,
+                 stack_profile_type &profile) {
+    return translate([&]() { m_interpreter.interpret(c, profile); });
+  }
+
+  ///
+  /// @brief Interpret code chunk and count executions of each instruction
+  ///
+  template <typename Alloc>
+  auto interpret(basic_prog_chunk<Alloc> const &c,
+                 opcode_profile_type &profile) {
+    return translate([&]() { m_interpreter.interpret(c, profile); });
+  }
+
+  ///
+  /// @brief Load code chunk in the register interpreter, blocks are
+  /// translated once hot unless set_tiers asked for translation at load
+  ///
+  /// @note only for instruction sets using the bytecode and value stack
+  ///       concepts
+  ///
+  template <typename Alloc> auto load(basic_prog_chunk<Alloc> const &c) {
+    return translate([&]() { m_reg_interpreter.load(c); });
+  }
+
+  ///
+  /// @brief Run the code chunk loaded in the register interpreter
+  ///
+  auto run() {
+    return translate([&]() { m_reg_interpreter.run(); });
+  }
+
+  ///
+  /// @brief Set promotion thresholds of the register interpreter tiers,
+  /// used from the next load. A block threshold of 0 translates at load
+  ///
+  void set_tiers(tier_thresholds const &tiers) noexcept {
+    m_reg_interpreter.set_tiers(tiers);
+  }
+
   ///
   /// @brief Assemble code chunk
   ///
@@ -61,10 +124,60 @@ public:
     return translate([&]() { return m_assembler.assemble(stream); });
   }
 
+  ///
+  /// @brief Assemble code chunk allocating from a memory resource
+  ///
+  auto assemble(std::istream &stream, std::pmr::memory_resource *res) const {
+    return translate([&]() { return m_assembler.assemble(stream, res); });
+  }
+
+  ///
+  /// @brief Assemble code chunk from a source buffer
+  ///
+  auto assemble(std::string_view source) const {
+    return translate([&]() { return m_assembler.assemble(source); });
+  }
+
+  ///
+  /// @brief Assemble code chunk from a source buffer allocating from a
+  /// memory resource
+  ///
+  auto assemble(std::string_view source,
+                std::pmr::memory_resource *res) const {
+    return translate([&]() { return m_assembler.assemble(source, res); });
+  }
+
+  ///
+  /// @brief Assemble a source buffer into a code sink
+  ///
+  template <typename Sink>
+  auto assemble_to(std::string_view source, Sink &sink) const {
+    return translate([&]() { m_assembler.assemble_to(source, sink); });
+  }
+
+#ifndef _WIN32
+  ///
+  /// @brief Assemble a memory mapped source file into a code sink
+  ///
+  template <typename Sink>
+  auto assemble_file(char const *path, Sink &sink) const {
+    return translate([&]() { m_assembler.assemble_file(path, sink); });
+  }
+#endif
+
+  ///
+  /// @brief Assemble code chunk from a source buffer on several threads
+  ///
+  auto assemble_parallel(std::string_view source, std::size_t jobs = 0) const {
+    return translate(
+        [&]() { return m_assembler.assemble_parallel(source, jobs); });
+  }
+
   ///
   /// @brief Disassemble code chunk
   ///
-  auto disassemble(prog_chunk const &c) {
+  template <typename Alloc>
+  auto disassemble(basic_prog_chunk<Alloc> const &c) {
     return translate([&]() { return m_disassembler.disassemble(c); });
   }
 };
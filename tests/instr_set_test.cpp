@@ -18,7 +18,11 @@
 
 #include "gtest/gtest.h"
 
+#include <array>
+#include <cstdint>
+#include <string>
 #include <type_traits>
+#include <vector>
 
 using namespace mvm;
 using namespace mvm::traits;
@@ -64,6 +68,17 @@ TEST(instr_set_test, main) {
                      list::mplist<ui32>>,
       "[-][instr_set_test] bad code types");
 
+  static_assert(
+      std::is_same_v<
+          list::at_t<1, test_instr_set_reg::instr_table>::bytecode_type,
+          list::mplist<ui8, ui8, ui8>>,
+      "[-][instr_set_test] bad register code types");
+  static_assert(
+      std::is_same_v<
+          list::at_t<2, test_instr_set_reg::instr_table>::bytecode_type,
+          list::mplist<>>,
+      "[-][instr_set_test] bad register code types");
+
   EXPECT_STREQ(test_traits::instr_names[0], "zero");
   EXPECT_STREQ(test_traits::instr_names[1], "jump");
   EXPECT_STREQ(test_traits::instr_names[2], "dup");
@@ -71,6 +86,84 @@ TEST(instr_set_test, main) {
   EXPECT_STREQ(test_traits::instr_names[4], "randn");
   EXPECT_STREQ(test_traits::instr_names[5], "rotln");
   EXPECT_STREQ(test_traits::instr_names[6], "add");
+
+  static_assert(test_traits::instr_index("zero") == 0,
+                "[-][instr_set_test] bad name lookup");
+  static_assert(test_traits::instr_index("add") == 6,
+                "[-][instr_set_test] bad name lookup");
+  static_assert(test_traits::instr_index("rotln") == 5,
+                "[-][instr_set_test] bad name lookup");
+  static_assert(test_traits::instr_index("ad") == test_traits::instr_set_size,
+                "[-][instr_set_test] bad name lookup");
+  static_assert(test_traits::instr_index("zeros") ==
+                    test_traits::instr_set_size,
+                "[-][instr_set_test] bad name lookup");
+}
+
+TEST(instr_set_test, metadata) {
+  using test_traits = instr_set_traits<test_instr_set>;
+  using test_traits2 = instr_set_traits<test_instr_set2>;
+
+  static_assert(test_traits::instr_lengths[1] == 5,
+                "[-][instr_set_test] bad instruction length");
+
+  // zero, jump, dup, push, randn, rotln, add
+  EXPECT_EQ(test_traits::instr_lengths,
+            (std::array<std::uint16_t, 7>{1, 5, 1, 5, 5, 5, 1}));
+  EXPECT_EQ(test_traits::instr_pops,
+            (std::array<std::uint8_t, 7>{0, 0, 1, 0, 0, 0, 2}));
+  EXPECT_EQ(test_traits::instr_pushes,
+            (std::array<std::uint8_t, 7>{1, 0, 2, 1, 0, 0, 1}));
+  EXPECT_EQ(test_traits2::instr_pushes, (std::array<std::uint8_t, 2>{2, 0}));
+
+  // ldi, sub, swap01, out0, mov10
+  using reg_traits = instr_set_traits<test_instr_set_reg>;
+  EXPECT_EQ(reg_traits::instr_pops_of<meta_register_file>,
+            (std::array<std::uint8_t, 5>{0, 2, 2, 1, 1}));
+  EXPECT_EQ(reg_traits::instr_pushes_of<meta_register_file>,
+            (std::array<std::uint8_t, 5>{1, 1, 2, 0, 1}));
+  EXPECT_EQ(reg_traits::instr_pops_of<meta_bytecode>,
+            (std::array<std::uint8_t, 5>{1, 0, 0, 0, 0}));
+  EXPECT_EQ(reg_traits::instr_pops, (std::array<std::uint8_t, 5>{}));
+
+  EXPECT_EQ(test_traits::instr_flags[0], 0);
+  EXPECT_EQ(test_traits::instr_flags[1], instr_flag::update_ip);
+  EXPECT_EQ(test_traits::instr_flags[3], instr_flag::pipe | instr_flag::pure);
+  EXPECT_EQ(test_traits::instr_flags[4], instr_flag::variable_push);
+  EXPECT_EQ(test_traits::instr_flags[5],
+            instr_flag::iterable | instr_flag::variable_push);
+  EXPECT_EQ(test_traits2::instr_flags[1], instr_flag::variable_push);
+
+  // table driven scan of a chunk: push 3, dup, add, jump 0
+  std::vector<ui8> code = {3, 3, 0, 0, 0, 2, 6, 1, 0, 0, 0, 0};
+  std::vector<std::size_t> offsets;
+  for (std::size_t i = 0; i < code.size();
+       i += test_traits::instr_lengths[code[i]]) {
+    offsets.push_back(i);
+  }
+  EXPECT_EQ(offsets, (std::vector<std::size_t>{0, 5, 6, 7}));
+}
+
+TEST(instr_set_test, visitor) {
+  using desc_type = test_instr_set::instr_table;
+
+  std::vector<std::string> visited;
+  auto visit = [&visited](auto &&arg) {
+    using instr_type = std::decay_t<decltype(arg)>;
+    visited.emplace_back(
+        typestring::char_seq<typename instr_type::name_type>::value);
+  };
+  for (std::size_t i : {6, 0, 3}) {
+    instr_set_visitor<desc_type>()(i, visit);
+  }
+  EXPECT_EQ(visited, (std::vector<std::string>{"add", "zero", "push"}));
+
+  try {
+    instr_set_visitor<desc_type>()(7, visit);
+    FAIL();
+  } catch (mexcept const &e) {
+    EXPECT_EQ(e.status(), status_type::INVALID_INSTR_OPCODE);
+  }
 }
 
 int instr_set_test(int argc, char *argv[]) {
@@ -14,8 +14,14 @@
 
 #include "gtest/gtest.h"
 
+#include <array>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <iostream>
 #include <limits>
+#include <string>
+#include <vector>
 
 #include "mvm/helpers/num_parse.h"
 
@@ -114,6 +120,34 @@ TEST(num_parse_test, parse_double) {
   EXPECT_EQ(resf64, -2.25);
 }
 
+TEST(num_parse_test, parse_native_repr) {
+  // unaligned operands, fast path against byte by byte decode
+  uint8_t code[9] = {0x0, 0xc0, 0x01, 0x80, 0xfe, 0x12, 0x34, 0x56, 0x78};
+  uint8_t const *ip = &code[1];
+
+  auto check = [ip](auto val, auto endian) {
+    using type = decltype(val);
+    using endian_type = decltype(endian);
+    EXPECT_EQ((parse<type, sizeof(type), endian_type>(ip)),
+              (parse_portable<type, sizeof(type), endian_type>(ip)));
+  };
+
+  check(uint16_t{}, little_endian_tag{});
+  check(uint16_t{}, big_endian_tag{});
+  check(uint32_t{}, little_endian_tag{});
+  check(uint32_t{}, big_endian_tag{});
+  check(uint64_t{}, little_endian_tag{});
+  check(uint64_t{}, big_endian_tag{});
+  check(int16_t{}, big_endian_tag{});
+  check(int32_t{}, little_endian_tag{});
+  check(int64_t{}, big_endian_tag{});
+  check(float{}, big_endian_tag{});
+  check(double{}, little_endian_tag{});
+
+  EXPECT_EQ((parse<uint32_t, 4, big_endian_tag>(ip)), 0xc00180feu);
+  EXPECT_EQ((parse<int16_t, 2, little_endian_tag>(ip)), 0x01c0);
+}
+
 TEST(num_parse_test, serial_unsigned) {
   auto bytes = serial<uint32_t, 4, little_endian_tag>("666");
   EXPECT_EQ(bytes, decltype(bytes)({0x9a, 0x02, 0x0, 0x0}));
@@ -139,6 +173,23 @@ TEST(num_parse_test, serial_float) {
   EXPECT_EQ(bytes4, decltype(bytes4)({0x0, 0x0, 0xa0, 0xbf}));
 }
 
+TEST(num_parse_test, serial_into) {
+  // operands written in place, after an unaligned opcode
+  std::array<uint8_t, 16> code{};
+  auto *out = serial_into<uint16_t, 2, big_endian_tag>("0x1234", &code[1]);
+  out = serial_into<int32_t, 4, little_endian_tag>("-4", out);
+  out = serial_into<double, 8, big_endian_tag>("1.5", out);
+
+  ASSERT_EQ(out, &code[15]);
+  EXPECT_EQ(code, decltype(code)({0x0, 0x12, 0x34, 0xfc, 0xff, 0xff, 0xff,
+                                  0x3f, 0xf8, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+                                  0x0}));
+  EXPECT_EQ((parse<double, 8, big_endian_tag>(&code[7])), 1.5);
+
+  EXPECT_THROW((serial_into<uint8_t, 1, little_endian_tag>("256", &code[0])),
+               std::invalid_argument);
+}
+
 TEST(num_parse_test, serial_parse_unsigned) {
   auto bytes = serial<uint32_t, 4, little_endian_tag>("666");
   auto res = parse<uint32_t, 4, little_endian_tag>(&bytes[0]);
@@ -175,6 +226,138 @@ TEST(num_parse_test, serial_parse_floating) {
   EXPECT_EQ(res, -2.5);
 }
 
+TEST(num_parse_test, serial_parse_floating_special) {
+  auto round_trip = [](auto val) {
+    using type = decltype(val);
+    auto bytes = serial_value<type, sizeof(type), big_endian_tag>(val);
+    return parse<type, sizeof(type), big_endian_tag>(&bytes[0]);
+  };
+
+  EXPECT_EQ(round_trip(0.0), 0.0);
+  EXPECT_TRUE(std::signbit(round_trip(-0.0)));
+  EXPECT_EQ(round_trip(std::numeric_limits<double>::denorm_min()),
+            std::numeric_limits<double>::denorm_min());
+  EXPECT_EQ(round_trip(std::numeric_limits<double>::max()),
+            std::numeric_limits<double>::max());
+  EXPECT_EQ(round_trip(-std::numeric_limits<double>::infinity()),
+            -std::numeric_limits<double>::infinity());
+  EXPECT_TRUE(std::isnan(round_trip(std::numeric_limits<double>::quiet_NaN())));
+  EXPECT_EQ(round_trip(0.1), 0.1);
+
+  EXPECT_EQ(round_trip(std::numeric_limits<float>::denorm_min()),
+            std::numeric_limits<float>::denorm_min());
+  EXPECT_EQ(round_trip(std::numeric_limits<float>::infinity()),
+            std::numeric_limits<float>::infinity());
+  EXPECT_EQ(round_trip(0.1f), 0.1f);
+
+  // bit exact encoding
+  auto bytes = serial_value<double, 8, little_endian_tag>(-0.0);
+  EXPECT_EQ(bytes, decltype(bytes)({0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x80}));
+
+  // doubles stored as binary32
+  auto bytes4 = serial_value<double, 4, little_endian_tag>(-1.25);
+  EXPECT_EQ(bytes4, decltype(bytes4)({0x0, 0x0, 0xa0, 0xbf}));
+  EXPECT_EQ((parse<double, 4, little_endian_tag>(&bytes4[0])), -1.25);
+}
+
+TEST(num_parse_test, parse_number) {
+  EXPECT_EQ((parse_number<uint32_t, 4>("666")), 666u);
+  EXPECT_EQ((parse_number<uint32_t, 4>("+666")), 666u);
+  EXPECT_EQ((parse_number<uint32_t, 4>("0x1F")), 31u);
+  EXPECT_EQ((parse_number<uint32_t, 4>("010")), 10u);
+  EXPECT_EQ((parse_number<uint32_t, 4>("4294967295")), 4294967295u);
+  EXPECT_EQ((parse_number<int32_t, 4>("-0x10")), -16);
+  EXPECT_EQ((parse_number<int32_t, 4>("-2147483648")),
+            std::numeric_limits<int32_t>::min());
+  EXPECT_EQ((parse_number<int64_t, 8>("-9223372036854775808")),
+            std::numeric_limits<int64_t>::min());
+  EXPECT_EQ((parse_number<double, 8>("-2.5e3")), -2500.0);
+  EXPECT_TRUE(std::isinf(*parse_number<double, 8>("-inf")));
+  EXPECT_TRUE(std::isnan(*parse_number<float, 4>("nan")));
+
+  // out of T or N bytes range
+  EXPECT_FALSE((parse_number<uint32_t, 4>("4294967296")));
+  EXPECT_FALSE((parse_number<uint32_t, 4>("-1")));
+  EXPECT_FALSE((parse_number<uint32_t, 2>("65536")));
+  EXPECT_FALSE((parse_number<int32_t, 4>("2147483648")));
+  EXPECT_FALSE((parse_number<int32_t, 4>("-2147483649")));
+  EXPECT_FALSE((parse_number<int16_t, 1>("128")));
+  EXPECT_TRUE((parse_number<int16_t, 1>("-128")));
+  EXPECT_FALSE((parse_number<float, 4>("1e39")));
+
+  // malformed
+  EXPECT_FALSE((parse_number<uint32_t, 4>("")));
+  EXPECT_FALSE((parse_number<uint32_t, 4>("12a")));
+  EXPECT_FALSE((parse_number<uint32_t, 4>("0x")));
+  EXPECT_FALSE((parse_number<int32_t, 4>("--1")));
+  EXPECT_FALSE((parse_number<int32_t, 4>("+-1")));
+  EXPECT_FALSE((parse_number<double, 8>("1.5x")));
+  EXPECT_FALSE((parse_number<double, 8>("+-1.5")));
+}
+
+TEST(num_parse_test, parse_number_edge_cases) {
+  // overflow
+  EXPECT_FALSE((parse_number<uint64_t, 8>("18446744073709551616")));
+  EXPECT_FALSE((parse_number<uint32_t, 4>("0x100000000")));
+  EXPECT_FALSE((parse_number<int8_t, 1>("0x80")));
+  EXPECT_FALSE((parse_number<double, 4>("3.5e38")));
+  EXPECT_FALSE((parse_number<double, 4>("-1e300")));
+  EXPECT_FALSE((parse_number<double, 8>("1e309")));
+
+  // garbage around the number
+  EXPECT_FALSE((parse_number<uint32_t, 4>(" 12")));
+  EXPECT_FALSE((parse_number<uint32_t, 4>("12 ")));
+  EXPECT_FALSE((parse_number<uint32_t, 4>("0x1g")));
+  EXPECT_FALSE((parse_number<uint32_t, 4>("1.0")));
+  EXPECT_FALSE((parse_number<double, 8>("1.5f")));
+  EXPECT_FALSE((parse_number<double, 8>("1e")));
+
+  // hexadecimal and decimal limits
+  EXPECT_EQ((parse_number<uint64_t, 8>("0xFFFFFFFFFFFFFFFF")),
+            std::numeric_limits<uint64_t>::max());
+  EXPECT_EQ((parse_number<uint32_t, 4>("0X1f")), 31u);
+  EXPECT_EQ((parse_number<int8_t, 1>("-0x80")), -128);
+  EXPECT_EQ((parse_number<int8_t, 1>("127")), 127);
+  EXPECT_EQ((parse_number<uint32_t, 4>("-0")), 0u);
+  EXPECT_EQ((parse_number<uint32_t, 4>("007")), 7u);
+
+  // largest finite values and infinities fit in the N bytes format
+  EXPECT_EQ((parse_number<double, 4>("3.4028234e38")), 3.4028234e38);
+  EXPECT_EQ((parse_number<double, 4>("-inf")),
+            -std::numeric_limits<double>::infinity());
+  EXPECT_EQ((parse_number<double, 8>("1e308")), 1e308);
+}
+
+// timing only, run with --gtest_also_run_disabled_tests
+TEST(num_parse_test, DISABLED_parse_number_throughput) {
+  std::vector<std::string> tokens;
+  for (uint32_t i = 0; i < 200000; ++i) {
+    tokens.push_back(std::to_string(i * 2654435761u));
+  }
+
+  auto time = [&tokens](auto &&parse) {
+    uint64_t sum{0};
+    auto start = std::chrono::steady_clock::now();
+    for (auto const &token : tokens) {
+      sum += parse(token);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    return std::make_pair(
+        sum, std::chrono::duration<double, std::micro>(stop - start).count());
+  };
+
+  auto [stoull_sum, stoull_us] = time(
+      [](std::string const &token) { return std::stoull(token, nullptr, 10); });
+  auto [from_chars_sum, from_chars_us] = time([](std::string const &token) {
+    return *parse_number<uint32_t, 4>(token);
+  });
+
+  EXPECT_EQ(stoull_sum, from_chars_sum);
+  std::cout << "[ PERF     ] " << tokens.size() << " tokens, stoull "
+            << stoull_us << " us, parse_number " << from_chars_us << " us"
+            << std::endl;
+}
+
 int num_parse_test(int argc, char *argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   ::testing::FLAGS_gtest_filter = "num_parse_test*";
@@ -19,6 +19,9 @@
 #include "mvm/macros.h"
 #include "mvm/types.h"
 
+#include <string>
+#include <vector>
+
 namespace mvm::test {
 
 struct test_instr_set : instr_set<test_instr_set> {
@@ -108,6 +111,12 @@ struct test_common_mixed_arithmetic : instr_set<test_common_mixed_arithmetic> {
 
   double ufadd(ui32 a, double b) { return static_cast<double>(a) + b; }
 
+  std::tuple<ui32, double> kmix() { return std::make_tuple(2, 2.5); }
+
+  std::vector<double> written;
+
+  void wd(double v) { written.push_back(v); }
+
   using endian_type = num::little_endian_tag;
 };
 
@@ -127,7 +136,13 @@ struct test_instr_set_extra : test_common_mixed_arithmetic {
       consumers_producer_instr<consumers<consumer<meta_double_stack, double>,
                                          consumer<meta_value_stack, ui32>>,
                                producer<meta_double_stack, double>, false,
-                               &me::ufadd, MVM_TSTRING("ufadd")>>;
+                               &me::ufadd, MVM_TSTRING("ufadd")>,
+      // one value to each stack
+      producers_instr<producers<producer<meta_value_stack, ui32>,
+                                producer<meta_double_stack, double>>,
+                      false, &me::kmix, MVM_TSTRING("kmix")>,
+      consumer_instr<consumer<meta_double_stack, double>, false, &me::wd,
+                     MVM_TSTRING("wd")>>;
 };
 
 struct test_instr_set_mixed : test_common_mixed_arithmetic {
@@ -147,4 +162,207 @@ struct test_instr_set_mixed : test_common_mixed_arithmetic {
                                producer<meta_value_stack, double>, false,
                                &me::ufadd, MVM_TSTRING("ufadd")>>;
 };
+
+struct test_instr_set_string : instr_set<test_instr_set_string> {
+  std::vector<std::string> written;
+
+  std::string kstr() { return std::string(32, 'm'); }
+
+  std::string cat(std::string a, std::string b) { return a + b; }
+
+  ui32 len(std::string a) { return static_cast<ui32>(a.size()); }
+
+  void write(std::string a) { written.push_back(std::move(a)); }
+
+  using endian_type = num::little_endian_tag;
+
+  using me = test_instr_set_string;
+  using instr_table = instr_set_desc<
+      producer_instr<producer<meta_value_stack, std::string>, false, &me::kstr,
+                     MVM_TSTRING("kstr")>,
+      consumer_producer_instr<consumer<meta_value_stack, std::string,
+                                       std::string>,
+                              producer<meta_value_stack, std::string>, false,
+                              &me::cat, MVM_TSTRING("cat")>,
+      consumer_producer_instr<consumer<meta_value_stack, std::string>,
+                              producer<meta_value_stack, ui32>, false, &me::len,
+                              MVM_TSTRING("len")>,
+      consumer_instr<consumer<meta_value_stack, std::string>, false, &me::write,
+                     MVM_TSTRING("write")>,
+      consumer_pipe<consumer<meta_value_stack, ui32>, MVM_TSTRING("pop")>>;
+};
+
+struct test_instr_set_reg : instr_set<test_instr_set_reg> {
+  std::vector<ui32> written;
+
+  ui32 load(ui32 val) { return val; }
+
+  ui32 sub(ui32 a, ui32 b) { return a - b; }
+
+  std::tuple<ui32, ui32> swap(ui32 a, ui32 b) { return std::make_tuple(b, a); }
+
+  void write(ui32 val) { written.push_back(val); }
+
+  using endian_type = num::little_endian_tag;
+
+  using me = test_instr_set_reg;
+  using reg_type = code_reg<ui8, ui32>;
+  using instr_table = instr_set_desc<
+      // ldi dst imm
+      consumer_producer_instr<consumer<meta_bytecode, ui32>,
+                              producer<meta_register_file, reg_type>, false,
+                              &me::load, MVM_TSTRING("ldi")>,
+      // sub dst src2 src1 (consumers from right to left)
+      consumer_producer_instr<consumer<meta_register_file, reg_type, reg_type>,
+                              producer<meta_register_file, reg_type>, false,
+                              &me::sub, MVM_TSTRING("sub")>,
+      // swap r0 and r1
+      consumer_producer_instr<
+          consumer<meta_register_file, reg<1, ui32>, reg<0, ui32>>,
+          producer<meta_register_file, reg<0, ui32>, reg<1, ui32>>, false,
+          &me::swap, MVM_TSTRING("swap01")>,
+      consumer_instr<consumer<meta_register_file, reg<0, ui32>>, false,
+                     &me::write, MVM_TSTRING("out0")>,
+      // mov r1 to r0
+      consumer_producer_pipe<consumer<meta_register_file, reg<1, ui32>>,
+                             producer<meta_register_file, reg<0, ui32>>,
+                             MVM_TSTRING("mov10")>>;
+};
+
+struct test_instr_set_in_place : instr_set<test_instr_set_in_place> {
+  std::vector<ui32> written;
+
+  ui32 sub(ui32 const &a, ui32 const &b) { return a - b; }
+
+  double kd() { return 2.5; }
+
+  ui32 trunc(double const &a) { return static_cast<ui32>(a); }
+
+  void write(ui32 val) { written.push_back(val); }
+
+  using endian_type = num::little_endian_tag;
+
+  using me = test_instr_set_in_place;
+  using instr_table = instr_set_desc<
+      consumer_producer_pipe<consumer<meta_bytecode, ui32>,
+                             producer<meta_value_stack, ui32>,
+                             MVM_TSTRING("push")>,
+      in_place_instr<consumer<meta_value_stack, ui32, ui32>,
+                     producer<meta_value_stack, ui32>, &me::sub,
+                     MVM_TSTRING("sub")>,
+      producer_instr<producer<meta_value_stack, double>, false, &me::kd,
+                     MVM_TSTRING("kd")>,
+      in_place_instr<consumer<meta_value_stack, double>,
+                     producer<meta_value_stack, ui32>, &me::trunc,
+                     MVM_TSTRING("trunc")>,
+      consumer_instr<consumer<meta_value_stack, ui32>, false, &me::write,
+                     MVM_TSTRING("write")>>;
+};
+
+struct test_instr_set_loop : instr_set<test_instr_set_loop> {
+  std::vector<ui32> written;
+
+  std::tuple<ui32, ui32> dup(ui32 val) { return std::make_tuple(val, val); }
+
+  ui32 add(ui32 a, ui32 b) { return a + b; }
+
+  ui32 sub(ui32 a, ui32 b) { return a - b; }
+
+  void jz(ip &eip, ui32 new_ip, ui32 val) {
+    if (val == 0) {
+      eip = new_ip;
+    } else {
+      ++eip;
+    }
+  }
+
+  void jump(ip &eip, ui32 val) { eip = val; }
+
+  void write(ui32 val) { written.push_back(val); }
+
+  std::vector<ui32> randn(ui32 n) { return std::vector<ui32>(n, n); }
+
+  ui32 sum(std::vector<ui32> &&vec) {
+    ui32 res{0};
+    for (auto v : vec) {
+      res += v;
+    }
+    return res;
+  }
+
+  double kd() { return 0.5; }
+
+  using endian_type = num::little_endian_tag;
+
+  using me = test_instr_set_loop;
+  using instr_table = instr_set_desc<
+      consumer_producer_pipe<consumer<meta_bytecode, ui32>,
+                             producer<meta_value_stack, ui32>,
+                             MVM_TSTRING("push")>,
+      consumer_pipe<consumer<meta_value_stack, ui32>, MVM_TSTRING("pop")>,
+      consumer_producer_instr<consumer<meta_value_stack, ui32>,
+                              producer<meta_value_stack, ui32, ui32>, false,
+                              &me::dup, MVM_TSTRING("dup")>,
+      consumer_producer_instr<consumer<meta_value_stack, ui32, ui32>,
+                              producer<meta_value_stack, ui32>, false, &me::add,
+                              MVM_TSTRING("add")>,
+      consumer_producer_instr<consumer<meta_value_stack, ui32, ui32>,
+                              producer<meta_value_stack, ui32>, false, &me::sub,
+                              MVM_TSTRING("sub")>,
+      consumers_instr<consumers<consumer<meta_value_stack, ui32>,
+                                consumer<meta_bytecode, ui32>>,
+                      true, &me::jz, MVM_TSTRING("jz")>,
+      consumer_instr<consumer<meta_bytecode, ui32>, true, &me::jump,
+                     MVM_TSTRING("jump")>,
+      consumer_instr<consumer<meta_value_stack, ui32>, false, &me::write,
+                     MVM_TSTRING("write")>,
+      consumer_producer_instr<consumer<meta_bytecode, ui32>,
+                              producer<meta_value_stack, std::vector<ui32>>,
+                              false, &me::randn, MVM_TSTRING("randn")>,
+      consumer_producer_instr<
+          iterable_consumer<meta_value_stack, std::vector<ui32> &&,
+                            count_from<consumer<meta_bytecode, ui32>>>,
+          producer<meta_value_stack, ui32>, false, &me::sum,
+          MVM_TSTRING("sum")>,
+      producer_instr<producer<meta_value_stack, double>, false, &me::kd,
+                     MVM_TSTRING("kd")>>;
+};
+
+// instruction set bigger than 256 instructions, the last ones use two
+// byte opcodes
+struct test_instr_set_ext : instr_set<test_instr_set_ext> {
+  std::vector<ui32> written;
+
+  ui32 add(ui32 a, ui32 b) { return a + b; }
+
+  void jz(ip &eip, ui32 new_ip, ui32 val) {
+    if (val == 0) {
+      eip = new_ip;
+    } else {
+      ++eip;
+    }
+  }
+
+  void write(ui32 val) { written.push_back(val); }
+
+  using endian_type = num::little_endian_tag;
+
+  using me = test_instr_set_ext;
+  using push_type = consumer_producer_pipe<consumer<meta_bytecode, ui32>,
+                                           producer<meta_value_stack, ui32>,
+                                           MVM_TSTRING("push")>;
+  using pop_type =
+      consumer_pipe<consumer<meta_value_stack, ui32>, MVM_TSTRING("pop")>;
+  using instr_table = details::join_t<
+      list::fill_t<299, pop_type, instr_set_desc<push_type>>,
+      instr_set_desc<
+          consumer_producer_instr<consumer<meta_value_stack, ui32, ui32>,
+                                  producer<meta_value_stack, ui32>, false,
+                                  &me::add, MVM_TSTRING("add")>,
+          consumers_instr<consumers<consumer<meta_value_stack, ui32>,
+                                    consumer<meta_bytecode, ui32>>,
+                          true, &me::jz, MVM_TSTRING("jz")>,
+          consumer_instr<consumer<meta_value_stack, ui32>, false, &me::write,
+                         MVM_TSTRING("write")>>>;
+};
 } // namespace mvm::test
\ No newline at end of file
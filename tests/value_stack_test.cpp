@@ -15,11 +15,34 @@
 #include "gtest/gtest.h"
 
 #include "mvm/helpers/list.h"
+#include "mvm/mapped_value_stack.h"
+#include "mvm/profiled_stack.h"
 #include "mvm/value_stack.h"
 
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
 using namespace mvm;
 using namespace list;
 
+namespace {
+struct move_only {
+  explicit move_only(int v) : val{std::make_unique<int>(v)} {}
+  std::unique_ptr<int> val;
+};
+
+#ifdef ENABLE_TRACES
+// only needed by the push traces
+std::ostream &operator<<(std::ostream &os, move_only const &m) {
+  return os << *m.val;
+}
+#endif
+} // namespace
+
 TEST(value_stack_test, single_type) {
   using stack = value_stack<mplist<int>>;
 
@@ -55,6 +78,199 @@ TEST(value_stack_test, multiple_type_bad_type) {
   EXPECT_ANY_THROW(s.template pop<int>());
 }
 
+TEST(value_stack_test, boxed_type) {
+  using stack = value_stack<mplist<int, std::string>>;
+
+  static_assert(
+      sizeof(traits::value_stack_traits<mplist<int, std::string>>::value_type) <
+          sizeof(std::string),
+      "[-][value_stack_test] string should be stored out of slots");
+
+  stack s;
+  s.push(std::string(64, 'a'));
+  s.push(1);
+  s.push(std::string("b"));
+
+  EXPECT_EQ("b", s.template pop<std::string>());
+  EXPECT_EQ(1, s.template pop<int>());
+  EXPECT_EQ(std::string(64, 'a'), s.template pop<std::string>());
+  EXPECT_ANY_THROW(s.template pop<std::string>());
+}
+
+TEST(value_stack_test, boxed_type_bad_type) {
+  using stack = value_stack<mplist<int, std::string>>;
+
+  stack s;
+  s.push(1);
+
+  EXPECT_ANY_THROW(s.template pop<std::string>());
+}
+
+TEST(value_stack_test, boxed_type_bad_type_recover) {
+  using stack = value_stack<mplist<int, std::string, std::vector<int>>>;
+
+  stack s;
+  s.push(std::string(64, 'a'));
+  s.push(std::string(64, 'b'));
+
+  // failed pops leave the stack as it was
+  EXPECT_THROW(s.template pop<int>(), mexcept);
+  auto pop_vector = [&s]() { s.template pop<std::vector<int>>(); };
+  EXPECT_EQ(translate(pop_vector), status_type::BAD_VALUE_TYPE);
+
+  s.push(std::string(64, 'c'));
+  EXPECT_EQ(std::string(64, 'c'), s.template pop<std::string>());
+  EXPECT_EQ(std::string(64, 'b'), s.template pop<std::string>());
+  EXPECT_EQ(std::string(64, 'a'), s.template pop<std::string>());
+  EXPECT_ANY_THROW(s.template pop<std::string>());
+}
+
+TEST(value_stack_test, move_only_type) {
+  using stack = value_stack<mplist<move_only>>;
+
+  stack s;
+  s.push(move_only{1});
+  s.push(move_only{2});
+
+  EXPECT_EQ(2, *s.template pop<move_only>().val);
+  EXPECT_EQ(1, *s.template pop<move_only>().val);
+}
+
+TEST(value_stack_test, move_only_multiple_type) {
+  using stack = value_stack<mplist<double, move_only>>;
+
+  stack s;
+  s.push(move_only{1});
+  s.push(2.0);
+
+  EXPECT_EQ(2.0, s.template pop<double>());
+  EXPECT_EQ(1, *s.template pop<move_only>().val);
+}
+
+TEST(value_stack_test, pmr_multiple_type) {
+  using stack = mvm::pmr::value_stack<mplist<int, std::string>>;
+
+  std::array<std::byte, 1024> buffer;
+  std::pmr::monotonic_buffer_resource res{buffer.data(), buffer.size(),
+                                          std::pmr::null_memory_resource()};
+
+  stack s{&res};
+  for (int i = 0; i < 8; ++i) {
+    s.push(i);
+    s.push(std::string(64, 'a'));
+  }
+
+  for (int i = 7; i >= 0; --i) {
+    EXPECT_EQ(std::string(64, 'a'), s.template pop<std::string>());
+    EXPECT_EQ(i, s.template pop<int>());
+  }
+
+  // buffer is exhausted and upstream resource does not allocate
+  EXPECT_THROW(
+      {
+        for (int i = 0; i < 1024; ++i) {
+          s.push(i);
+        }
+      },
+      std::bad_alloc);
+}
+
+TEST(value_stack_test, mapped_multiple_type) {
+  using stack = mapped_value_stack<mplist<int, std::string>>;
+
+  stack s;
+  s.push(1);
+  s.push(std::string(64, 'a'));
+
+  // large values live in their slot and never move
+  auto const *str = &s.template peek<std::string>(0);
+  for (int i = 0; i < 4096; ++i) {
+    s.push(i);
+  }
+  EXPECT_EQ(str, &s.template peek<std::string>(4096));
+  for (int i = 4095; i >= 0; --i) {
+    ASSERT_EQ(i, s.template pop<int>());
+  }
+
+  auto pop_int = [&s]() { s.template pop<int>(); };
+  EXPECT_EQ(translate(pop_int), status_type::BAD_VALUE_TYPE);
+  EXPECT_EQ(std::string(64, 'a'), s.template pop<std::string>());
+  EXPECT_EQ(1, s.template pop<int>());
+  EXPECT_ANY_THROW(s.template pop<int>());
+}
+
+TEST(value_stack_test, mapped_deep) {
+  using stack = mapped_value_stack<mplist<int>, 1 << 20>;
+
+  stack s;
+  for (int i = 0; i < (1 << 20); ++i) {
+    s.push(i);
+  }
+  EXPECT_EQ(std::size_t{1 << 20}, s.size());
+
+  try {
+    s.push(0);
+    FAIL();
+  } catch (mexcept const &e) {
+    EXPECT_EQ(status_type::PUSH_FULL_STACK, e.status());
+  }
+
+  for (int i = (1 << 20) - 1; i >= 0; --i) {
+    ASSERT_EQ(i, s.template pop<int>());
+  }
+}
+
+TEST(value_stack_test, mapped_move_only) {
+  using stack = mapped_value_stack<mplist<move_only>, 16>;
+
+  stack s;
+  s.push(move_only{1});
+  s.push(move_only{2});
+
+  EXPECT_EQ(2, *s.template pop<move_only>().val);
+  // destructor of the remaining value runs with the stack one
+}
+
+TEST(value_stack_test, profiled_high_water_mark) {
+  using stack = profiled_stack<value_stack<mplist<int, double>>>;
+
+  stack s;
+  s.push(1);
+  s.push(2.0);
+  s.push(3);
+  EXPECT_EQ(3, s.template pop<int>());
+  s.push(4);
+  EXPECT_EQ(3u, s.high_water_mark());
+
+  EXPECT_EQ(4, s.template pop<int>());
+  EXPECT_EQ(2.0, s.template pop<double>());
+  EXPECT_EQ(3u, s.high_water_mark());
+
+  // depth is measured from the depth at prepare time
+  s.prepare(2, false);
+  EXPECT_EQ(0u, s.high_water_mark());
+  s.push(5);
+  EXPECT_EQ(1u, s.high_water_mark());
+}
+
+TEST(value_stack_test, profiled_fixed_capacity) {
+  using stack = profiled_stack<value_stack<mplist<int>>>;
+
+  stack s;
+  s.prepare(2, true);
+  s.push(1);
+  s.push(2);
+
+  try {
+    s.push(3);
+    FAIL();
+  } catch (mexcept const &e) {
+    EXPECT_EQ(status_type::PUSH_FULL_STACK, e.status());
+  }
+
+  EXPECT_EQ(2, s.template pop<int>());
+}
+
 int value_stack_test(int argc, char *argv[]) {
   ::testing::InitGoogleTest(&argc, argv);
   ::testing::FLAGS_gtest_filter = "value_stack_test*";
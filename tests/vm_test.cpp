@@ -12,17 +12,82 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "mvm/mapped_value_stack.h"
 #include "mvm/program.h"
+#include "mvm/register_file.h"
 #include "mvm/vm.h"
 #include "test_common.h"
 
 #include "gtest/gtest.h"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory_resource>
 #include <sstream>
+#include <variant>
 
 using namespace mvm;
 using namespace mvm::test;
 
+namespace {
+// loop set built with the opcode profile of the countdown loop
+struct test_instr_set_prof : test_instr_set_loop {};
+
+// loop set built with the profile of a program that did not run
+struct test_instr_set_empty_prof : test_instr_set_loop {};
+
+// register and stack producers, the register index is read from the code
+struct test_instr_set_split : instr_set<test_instr_set_split> {
+  std::vector<ui32> written;
+
+  std::tuple<ui32, ui32> split(ui32 val) { return {val, val + 1}; }
+
+  void write(ui32 val) { written.push_back(val); }
+
+  using endian_type = num::little_endian_tag;
+
+  using me = test_instr_set_split;
+  using instr_table = instr_set_desc<
+      // split dst imm
+      consumers_producers_instr<
+          consumers<consumer<meta_bytecode, ui32>>,
+          producers<producer<meta_register_file, code_reg<ui8, ui32>>,
+                    producer<meta_value_stack, ui32>>,
+          false, &me::split, MVM_TSTRING("split")>,
+      consumer_instr<consumer<meta_value_stack, ui32>, false, &me::write,
+                     MVM_TSTRING("write")>,
+      consumer_instr<consumer<meta_register_file, reg<2, ui32>>, false,
+                     &me::write, MVM_TSTRING("out2")>>;
+};
+
+// custom serializer without the in place write form
+struct serial_only_serializer {
+  template <typename T, std::size_t N, typename Endian>
+  auto serial(std::string_view str) const {
+    return bytecode_serializer{}.serial<T, N, Endian>(str);
+  }
+
+  template <typename T, std::size_t N, typename Endian>
+  auto parse(uint8_t const *ip) const {
+    return bytecode_serializer{}.parse<T, N, Endian>(ip);
+  }
+};
+} // namespace
+
+// as emitted by write_opcode_profile
+template <> struct mvm::traits::opcode_counts<test_instr_set_prof> {
+  static constexpr std::array<std::uint64_t, 11> value = {4u, 1u, 6u, 0u,
+                                                          3u, 3u, 2u, 3u,
+                                                          0u, 0u, 0u};
+};
+
+template <> struct mvm::traits::opcode_counts<test_instr_set_empty_prof> {
+  static constexpr std::array<std::uint64_t, 11> value = {};
+};
+
 namespace {
 class vm_test : public ::testing::Test {
 protected:
@@ -67,6 +132,21 @@ protected:
   using vm3_type = vm<test_instr_set_mixed>;
   test_instr_set_mixed iset3;
   vm3_type vm3{iset3};
+
+  using vm4_type = vm<test_instr_set_string>;
+  test_instr_set_string iset4;
+  vm4_type vm4{iset4};
+
+  using reg_instances_list =
+      list::mplist<meta_bytecode<bytecode_serializer>,
+                   meta_register_file<register_file<4, ui32>>>;
+  using vm5_type = vm<test_instr_set_reg, reg_instances_list>;
+  test_instr_set_reg iset5;
+  vm5_type vm5{iset5};
+
+  using vm6_type = vm<test_instr_set_loop>;
+  test_instr_set_loop iset6;
+  vm6_type vm6{iset6};
 };
 } // namespace
 
@@ -83,9 +163,108 @@ TEST_F(vm_test, assemble_prog) {
                        0x0, 0x5, 0x3, 0x0, 0x0, 0x0, 0x1, 0x0, 0x0, 0x0, 0x0}});
 }
 
+TEST_F(vm_test, assemble_serializer_write) {
+  using endian_type = num::little_endian_tag;
+  using write_type = std::uint8_t *;
+  static_assert(concept ::has_serial_write_v<bytecode_serializer, ui32, 4,
+                                             endian_type, write_type>);
+  static_assert(!concept ::has_serial_write_v<serial_only_serializer, ui32, 4,
+                                              endian_type, write_type>);
+
+  // serializers providing serial only are still supported
+  using instances_list =
+      list::mplist<meta_bytecode<serial_only_serializer>,
+                   meta_value_stack<value_stack<list::mplist<ui32>>>>;
+  vm<test_instr_set, instances_list> vm_serial{iset1};
+  check_assembler_ok(vm_serial, "push 1\ndup\nrandn 2",
+                     {{0x3, 0x1, 0x0, 0x0, 0x0, 0x2, 0x4, 0x2, 0x0, 0x0,
+                       0x0}});
+  check_assembler_nok(vm_serial, "push abc", status_type::BAD_INSTR_OPERAND);
+}
+
+TEST_F(vm_test, assemble_buffer) {
+  // tokens are read in place, whatever the blanks and line endings
+  std::string_view source = "  push\t1\r\ndup\r\n  zero  \nrandn 2\n";
+  auto res = vm1.assemble(source);
+  ASSERT_EQ(std::get<0>(res), status_type::SUCCESS);
+  EXPECT_EQ(std::get<1>(res).value().code,
+            (std::vector<uint8_t>{0x3, 0x1, 0x0, 0x0, 0x0, 0x2, 0x0, 0x4, 0x2,
+                                  0x0, 0x0, 0x0}));
+
+  EXPECT_EQ(std::get<0>(vm1.assemble(std::string_view{"dup\n\nzero"})),
+            status_type::NO_INSTR_NAME);
+}
+
+TEST_F(vm_test, assemble_parallel) {
+  std::string source;
+  for (std::size_t i = 0; i < 40000; ++i) {
+    source += "push " + std::to_string(i) + "\ndup\nrandn 2\n";
+  }
+  using assembler_type = assembler<test_instr_set, bytecode_serializer>;
+  ASSERT_GT(source.size(), 4 * assembler_type::min_piece_size);
+
+  auto serial = vm1.assemble(std::string_view{source});
+  auto parallel = vm1.assemble_parallel(source, 4);
+  ASSERT_EQ(std::get<0>(serial), status_type::SUCCESS);
+  ASSERT_EQ(std::get<0>(parallel), status_type::SUCCESS);
+  EXPECT_EQ(std::get<1>(parallel).value().code,
+            std::get<1>(serial).value().code);
+
+  // errors of any piece are reported
+  source += "bad\n";
+  EXPECT_EQ(std::get<0>(vm1.assemble_parallel(source, 4)),
+            status_type::BAD_INSTR_NAME);
+
+  // small sources are not split
+  auto small = vm1.assemble_parallel("push 1\ndup", 4);
+  ASSERT_EQ(std::get<0>(small), status_type::SUCCESS);
+  EXPECT_EQ(std::get<1>(small).value().code,
+            (std::vector<uint8_t>{0x3, 0x1, 0x0, 0x0, 0x0, 0x2}));
+}
+
+TEST_F(vm_test, assemble_to_sink) {
+  std::string_view source = "push 1\ndup\nrandn 2\n";
+  std::vector<uint8_t> exp_bytes{0x3, 0x1, 0x0, 0x0, 0x0, 0x2,
+                                 0x4, 0x2, 0x0, 0x0, 0x0};
+
+  std::vector<uint8_t> bytes;
+  buffer_sink<std::vector<uint8_t>> sink{bytes};
+  EXPECT_EQ(vm1.assemble_to(source, sink), status_type::SUCCESS);
+  EXPECT_EQ(bytes, exp_bytes);
+
+  // bytecode is emitted one instruction at a time
+  struct counting_sink {
+    std::size_t writes{0};
+    std::size_t max_size{0};
+    void write(std::uint8_t const *, std::size_t size) {
+      ++writes;
+      max_size = std::max(max_size, size);
+    }
+  } counter;
+  EXPECT_EQ(vm1.assemble_to(source, counter), status_type::SUCCESS);
+  EXPECT_EQ(counter.writes, 3u);
+  EXPECT_EQ(counter.max_size, 5u);
+
+  // from a mapped file to a stream
+  char const *path = "mvm_assemble_to_sink.mas";
+  std::ofstream(path) << source;
+  std::ostringstream out;
+  stream_sink out_sink{out};
+  EXPECT_EQ(vm1.assemble_file(path, out_sink), status_type::SUCCESS);
+  std::remove(path);
+  auto out_str = out.str();
+  EXPECT_EQ(std::vector<uint8_t>(out_str.begin(), out_str.end()), exp_bytes);
+
+  EXPECT_EQ(vm1.assemble_file("mvm_no_such_file.mas", out_sink),
+            status_type::IO_ERROR);
+}
+
 TEST_F(vm_test, assemble_bad) {
   check_assembler_nok(vm1, "bad", status_type::BAD_INSTR_NAME);
   check_assembler_nok(vm1, "push 1 2", status_type::BAD_INSTR_OPERAND);
+  check_assembler_nok(vm1, "push 1 2 3 4", status_type::BAD_INSTR_OPERAND);
+  check_assembler_nok(vm1, "push abc", status_type::BAD_INSTR_OPERAND);
+  check_assembler_nok(vm1, "push 4294967296", status_type::BAD_INSTR_OPERAND);
   check_assembler_nok(vm1, "push", status_type::BAD_INSTR_OPERAND);
   check_assembler_nok(vm1, "zero 1", status_type::BAD_INSTR_OPERAND);
 }
@@ -136,6 +315,72 @@ TEST_F(vm_test, interpret_instr_extended) {
   EXPECT_EQ(vm2.interpret(prog_chunk({0x2, 0x3, 0x4})), status_type::SUCCESS);
 }
 
+TEST_F(vm_test, interpret_multi_producers) {
+
+  // kmix pushes 2 on unsigned stack and 2.5 on double stack, ufadd adds them
+  EXPECT_EQ(vm2.interpret(prog_chunk({0x5, 0x4, 0x6})), status_type::SUCCESS);
+  EXPECT_EQ(iset2.written, std::vector<double>{4.5});
+
+  // destination register read before the consumed immediate
+  using split_instances_list =
+      list::mplist<meta_bytecode<bytecode_serializer>,
+                   meta_value_stack<value_stack<list::mplist<ui32>>>,
+                   meta_register_file<register_file<4, ui32>>>;
+  test_instr_set_split iset;
+  vm<test_instr_set_split, split_instances_list> svm{iset};
+  std::istringstream sstr("split 2 7\nwrite\nout2");
+  auto res = svm.assemble(sstr);
+  ASSERT_EQ(std::get<0>(res), status_type::SUCCESS);
+  EXPECT_EQ(std::get<1>(res).value().code,
+            (std::vector<ui8>{0x0, 0x2, 0x7, 0x0, 0x0, 0x0, 0x1, 0x2}));
+  EXPECT_EQ(svm.interpret(std::get<1>(res).value()), status_type::SUCCESS);
+  EXPECT_EQ(iset.written, (std::vector<ui32>{8, 7}));
+}
+
+TEST_F(vm_test, interpret_in_place) {
+  // push 7, push 3, sub, kd, trunc, sub, write
+  prog_chunk chunk({0x0, 0x7, 0x0, 0x0, 0x0, 0x0, 0x3, 0x0, 0x0, 0x0, 0x1, 0x2,
+                    0x3, 0x1, 0x4});
+
+  test_instr_set_in_place iset;
+  vm<test_instr_set_in_place> mvm{iset};
+  EXPECT_EQ(mvm.interpret(chunk), status_type::SUCCESS);
+  EXPECT_EQ(iset.written, std::vector<ui32>{2});
+
+  EXPECT_EQ(mvm.interpret(prog_chunk({0x0, 0x7, 0x0, 0x0, 0x0, 0x1})),
+            status_type::POP_EMPTY_STACK);
+
+  // push 7, trunc reads an ui32 as a double
+  EXPECT_EQ(mvm.interpret(prog_chunk({0x0, 0x7, 0x0, 0x0, 0x0, 0x3})),
+            status_type::BAD_VALUE_TYPE);
+
+  // same program on stacks with slots in a memory mapping
+  using mapped_instances_list = list::mplist<
+      meta_bytecode<bytecode_serializer>,
+      meta_value_stack<mapped_value_stack<list::mplist<ui32, double>>>>;
+  test_instr_set_in_place mapped_iset;
+  vm<test_instr_set_in_place, mapped_instances_list> mapped_vm{mapped_iset};
+  EXPECT_EQ(mapped_vm.interpret(chunk), status_type::SUCCESS);
+  EXPECT_EQ(mapped_iset.written, std::vector<ui32>{2});
+
+  // replaced slots are not counted twice in the stack depth
+  using profiled_instances_list =
+      list::mplist<meta_bytecode<bytecode_serializer>,
+                   meta_value_stack<profiled_stack<
+                       value_stack<list::mplist<ui32, double>>>>>;
+  using profiled_vm_type =
+      vm<test_instr_set_in_place, profiled_instances_list>;
+  test_instr_set_in_place profiled_iset;
+  profiled_vm_type profiled_vm{profiled_iset};
+  profiled_vm_type::stack_profile_type profile;
+  EXPECT_EQ(profiled_vm.interpret(chunk, profile), status_type::SUCCESS);
+  EXPECT_EQ(profile.high_water[1], 2u);
+
+  profile.fixed_capacity = true;
+  EXPECT_EQ(profiled_vm.interpret(chunk, profile), status_type::SUCCESS);
+  EXPECT_EQ(profiled_iset.written, (std::vector<ui32>{2, 2}));
+}
+
 TEST_F(vm_test, interpret_instr_mixed) {
 
   // test language with variant stack
@@ -150,6 +395,365 @@ TEST_F(vm_test, interpret_instr_mixed) {
   EXPECT_EQ(vm3.interpret(prog_chunk({0x2, 0x3, 0x4})), status_type::SUCCESS);
 }
 
+TEST_F(vm_test, interpret_instr_string) {
+
+  // test language with strings stored out of the stack slots
+
+  // kstr, kstr, cat, write
+  EXPECT_EQ(vm4.interpret(prog_chunk({0x0, 0x0, 0x1, 0x3})),
+            status_type::SUCCESS);
+
+  // kstr, len, pop
+  EXPECT_EQ(vm4.interpret(prog_chunk({0x0, 0x2, 0x4})), status_type::SUCCESS);
+
+  std::vector<std::string> exp_written = {std::string(64, 'm')};
+  EXPECT_EQ(iset4.written, exp_written);
+
+  // len of an ui32
+  EXPECT_EQ(vm4.interpret(prog_chunk({0x0, 0x2, 0x2})),
+            status_type::BAD_VALUE_TYPE);
+}
+
+TEST_F(vm_test, assemble_register) {
+  check_assembler_ok(vm5, "ldi 2 7", {{0x0, 0x2, 0x7, 0x0, 0x0, 0x0}});
+  check_assembler_ok(vm5, "sub 0 1 2", {{0x1, 0x0, 0x1, 0x2}});
+  check_assembler_ok(vm5, "swap01", {0x2});
+  check_assembler_nok(vm5, "sub 0 1", status_type::BAD_INSTR_OPERAND);
+}
+
+TEST_F(vm_test, interpret_register) {
+  std::istringstream sstr(
+      "ldi 1 3\nldi 2 10\nsub 0 1 2\nout0\nldi 1 1\nswap01\nout0\nmov10\nout0");
+  auto res = vm5.assemble(sstr);
+  ASSERT_EQ(std::get<0>(res), status_type::SUCCESS);
+
+  EXPECT_EQ(vm5.interpret(std::get<1>(res).value()), status_type::SUCCESS);
+  std::vector<ui32> exp_written = {7, 1, 7};
+  EXPECT_EQ(iset5.written, exp_written);
+
+  auto dis = vm5.disassemble(std::get<1>(res).value());
+  EXPECT_EQ(std::get<1>(dis).value(),
+            "ldi 1 3\nldi 2 10\nsub 0 1 2\nout0\nldi 1 1\nswap01\nout0\nmov10\n"
+            "out0\n");
+
+  // ldi r4 is out of the register file
+  EXPECT_EQ(vm5.interpret(prog_chunk({0x0, 0x4, 0x1, 0x0, 0x0, 0x0})),
+            status_type::INVALID_REGISTER);
+}
+
+TEST_F(vm_test, run_translated) {
+  // count down from 3
+  std::istringstream sstr("push 3\ndup\nwrite\npush 1\nsub\ndup\njz 24\njump "
+                          "5\npop\nrandn 3\nsum 3\npush 1\nadd\nwrite");
+  auto res = vm6.assemble(sstr);
+  ASSERT_EQ(std::get<0>(res), status_type::SUCCESS);
+  auto const &chunk = std::get<1>(res).value();
+
+  EXPECT_EQ(vm6.interpret(chunk), status_type::SUCCESS);
+  std::vector<ui32> exp_written = {3, 2, 1, 10};
+  EXPECT_EQ(iset6.written, exp_written);
+
+  // same result without pipes being executed
+  iset6.written.clear();
+  EXPECT_EQ(vm6.load(chunk), status_type::SUCCESS);
+  EXPECT_EQ(vm6.run(), status_type::SUCCESS);
+  EXPECT_EQ(iset6.written, exp_written);
+
+  iset6.written.clear();
+  EXPECT_EQ(vm6.run(), status_type::SUCCESS);
+  EXPECT_EQ(iset6.written, exp_written);
+
+  // immediates are folded in their readers
+  using code_instances_list =
+      list::mplist<meta_bytecode<bytecode_serializer>>;
+  reg_interpreter<test_instr_set_loop, code_instances_list> rvm{iset6};
+  rvm.set_tiers({0, 16});
+  prog_chunk folded{{0x0, 0x1, 0x0, 0x0, 0x0, 0x0, 0x2, 0x0, 0x0, 0x0, 0x3,
+                     0x7}};
+  rvm.load(folded);
+  EXPECT_EQ(rvm.instr_count(), 2u);
+  rvm.run();
+  EXPECT_EQ(iset6.written.back(), 3u);
+  EXPECT_EQ(rvm.size(), 0u);
+
+  // add with a single value on the stack
+  prog_chunk empty{{0x0, 0x1, 0x0, 0x0, 0x0, 0x3}};
+  EXPECT_EQ(vm6.load(empty), status_type::SUCCESS);
+  EXPECT_EQ(vm6.run(), status_type::POP_EMPTY_STACK);
+
+  // bad opcode at jump target
+  prog_chunk bad{{0x6, 0x6, 0x0, 0x0, 0x0, 0x0, 0x90}};
+  EXPECT_EQ(vm6.load(bad), status_type::SUCCESS);
+  EXPECT_EQ(vm6.run(), status_type::INVALID_INSTR_OPCODE);
+}
+
+TEST_F(vm_test, run_quickened) {
+  using code_instances_list =
+      list::mplist<meta_bytecode<bytecode_serializer>>;
+  reg_interpreter<test_instr_set_loop, code_instances_list> rvm{iset6};
+  rvm.set_tiers({0, 16});
+
+  // loop body is translated on first jump, dup of the counter is guarded
+  std::istringstream sstr(
+      "push 3\ndup\nwrite\npush 1\nsub\ndup\njz 24\njump 5\npop");
+  auto res = vm6.assemble(sstr);
+  ASSERT_EQ(std::get<0>(res), status_type::SUCCESS);
+  auto const &chunk = std::get<1>(res).value();
+
+  rvm.load(chunk);
+  EXPECT_EQ(rvm.quick_count(), rvm.instr_count());
+  rvm.run();
+  EXPECT_EQ(rvm.quick_count(), rvm.instr_count());
+  std::vector<ui32> exp_written = {3, 2, 1};
+  EXPECT_EQ(iset6.written, exp_written);
+
+  // write sees a double on its second run and is deoptimized
+  std::istringstream sstr_bad(
+      "push 0\npush 7\njump 26\npush 1\nkd\njump 26\nwrite\njz 15");
+  auto res_bad = vm6.assemble(sstr_bad);
+  ASSERT_EQ(std::get<0>(res_bad), status_type::SUCCESS);
+  auto const &chunk_bad = std::get<1>(res_bad).value();
+
+  iset6.written.clear();
+  rvm.load(chunk_bad);
+  EXPECT_EQ(rvm.quick_count(), 3u);
+  EXPECT_THROW(rvm.run(), mexcept);
+  EXPECT_EQ(rvm.quick_count(), rvm.instr_count() - 1);
+  EXPECT_EQ(iset6.written, std::vector<ui32>{7});
+
+  // same error as the plain interpreter
+  iset6.written.clear();
+  EXPECT_EQ(vm6.interpret(chunk_bad), status_type::BAD_VALUE_TYPE);
+  EXPECT_EQ(iset6.written, std::vector<ui32>{7});
+
+  // add reads a double produced in the same block, it is not quickened
+  // at load and fails as in the plain interpreter
+  std::istringstream sstr_mixed("kd\npush 1\nadd\nwrite");
+  auto res_mixed = vm6.assemble(sstr_mixed);
+  ASSERT_EQ(std::get<0>(res_mixed), status_type::SUCCESS);
+  auto const &chunk_mixed = std::get<1>(res_mixed).value();
+
+  iset6.written.clear();
+  EXPECT_EQ(vm6.interpret(chunk_mixed), status_type::BAD_VALUE_TYPE);
+  rvm.load(chunk_mixed);
+  EXPECT_EQ(rvm.quick_count(), 2u);
+  EXPECT_THROW(rvm.run(), mexcept);
+  EXPECT_EQ(vm6.load(chunk_mixed), status_type::SUCCESS);
+  EXPECT_EQ(vm6.run(), status_type::BAD_VALUE_TYPE);
+  EXPECT_TRUE(iset6.written.empty());
+}
+
+TEST_F(vm_test, run_trace) {
+  using code_instances_list =
+      list::mplist<meta_bytecode<bytecode_serializer>>;
+  reg_interpreter<test_instr_set_loop, code_instances_list> rvm{iset6};
+
+  // count down from 40, the loop body has a variable producer
+  std::istringstream sstr("push 40\ndup\nwrite\npush 1\nsub\ndup\njz 35\n"
+                          "randn 2\nsum 2\npop\njump 5\npop");
+  auto res = vm6.assemble(sstr);
+  ASSERT_EQ(std::get<0>(res), status_type::SUCCESS);
+  auto const &chunk = std::get<1>(res).value();
+
+  EXPECT_EQ(vm6.interpret(chunk), status_type::SUCCESS);
+  auto exp_written = iset6.written;
+  ASSERT_EQ(exp_written.size(), 40u);
+
+  iset6.written.clear();
+  rvm.load(chunk);
+  rvm.run();
+  EXPECT_EQ(rvm.trace_count(), 1u);
+  EXPECT_EQ(iset6.written, exp_written);
+  EXPECT_EQ(rvm.size(), 0u);
+
+  // trace is reused by the next runs
+  iset6.written.clear();
+  rvm.run();
+  EXPECT_EQ(rvm.trace_count(), 1u);
+  EXPECT_EQ(iset6.written, exp_written);
+  EXPECT_EQ(rvm.size(), 0u);
+
+  // no trace below the threshold
+  rvm.set_tiers({0, 0});
+  rvm.load(chunk);
+  rvm.run();
+  EXPECT_EQ(rvm.trace_count(), 0u);
+}
+
+TEST_F(vm_test, run_tiered) {
+  using code_instances_list =
+      list::mplist<meta_bytecode<bytecode_serializer>>;
+  reg_interpreter<test_instr_set_loop, code_instances_list> rvm{iset6};
+
+  std::istringstream sstr("push 40\ndup\nwrite\npush 1\nsub\ndup\njz 35\n"
+                          "randn 2\nsum 2\npop\njump 5\npop");
+  auto res = vm6.assemble(sstr);
+  ASSERT_EQ(std::get<0>(res), status_type::SUCCESS);
+  auto const &chunk = std::get<1>(res).value();
+
+  EXPECT_EQ(vm6.interpret(chunk), status_type::SUCCESS);
+  auto exp_written = iset6.written;
+
+  // nothing translated at load by default
+  rvm.load(chunk);
+  EXPECT_EQ(rvm.block_count(), 0u);
+
+  // unless asked for
+  rvm.set_tiers({0, 16});
+  rvm.load(chunk);
+  EXPECT_NE(rvm.block_count(), 0u);
+
+  rvm.set_tiers({2, 4});
+  rvm.load(chunk);
+  EXPECT_EQ(rvm.block_count(), 0u);
+  EXPECT_EQ(rvm.instr_count(), 0u);
+
+  // only the three loop blocks are promoted, entry and exit stay cold
+  iset6.written.clear();
+  rvm.run();
+  EXPECT_EQ(rvm.block_count(), 3u);
+  EXPECT_EQ(rvm.trace_count(), 1u);
+  EXPECT_EQ(iset6.written, exp_written);
+  EXPECT_EQ(rvm.size(), 0u);
+
+  // same through the vm
+  iset6.written.clear();
+  vm6.set_tiers({2, 4});
+  EXPECT_EQ(vm6.load(chunk), status_type::SUCCESS);
+  EXPECT_EQ(vm6.run(), status_type::SUCCESS);
+  EXPECT_EQ(iset6.written, exp_written);
+
+  // cold code reports the same errors without being translated
+  std::istringstream sstr_err("push 1\npop\npop");
+  res = vm6.assemble(sstr_err);
+  ASSERT_EQ(std::get<0>(res), status_type::SUCCESS);
+  rvm.load(std::get<1>(res).value());
+  EXPECT_THROW(rvm.run(), mexcept);
+  EXPECT_EQ(rvm.block_count(), 0u);
+  EXPECT_EQ(vm6.load(std::get<1>(res).value()), status_type::SUCCESS);
+  EXPECT_EQ(vm6.run(), status_type::POP_EMPTY_STACK);
+}
+
+TEST_F(vm_test, extended_opcodes) {
+  test_instr_set_ext iset;
+  vm<test_instr_set_ext> evm{iset};
+
+  using ext_traits = traits::instr_set_traits<test_instr_set_ext>;
+  static_assert(ext_traits::is_extended && ext_traits::instr_set_size == 302,
+                "[-][vm_test] bad extended set");
+  EXPECT_EQ(ext_traits::instr_lengths[0], 5);
+  EXPECT_EQ(ext_traits::instr_lengths[299], 2);
+  EXPECT_EQ(ext_traits::instr_lengths[300], 6);
+
+  // duplicated names resolve to the first instruction
+  static_assert(ext_traits::instr_index("pop") == 1,
+                "[-][vm_test] bad name lookup");
+  static_assert(ext_traits::instr_index("write") == 301,
+                "[-][vm_test] bad name lookup");
+
+  // jz lands on an instruction with a two byte opcode
+  std::string prog = "push 3\npush 4\nadd\npush 0\njz 28\npush 9\nwrite\n";
+  std::istringstream sstr(prog);
+  auto res = evm.assemble(sstr);
+  ASSERT_EQ(std::get<0>(res), status_type::SUCCESS);
+  auto const &chunk = std::get<1>(res).value();
+
+  ASSERT_EQ(chunk.code.size(), 30u);
+  EXPECT_EQ(chunk.code[10], 0xFF);
+  EXPECT_EQ(chunk.code[11], 44);
+  EXPECT_EQ(chunk.code[17], 0xFF);
+  EXPECT_EQ(chunk.code[18], 45);
+  EXPECT_EQ(chunk.code[28], 0xFF);
+  EXPECT_EQ(chunk.code[29], 46);
+
+  auto dis = evm.disassemble(chunk);
+  ASSERT_EQ(std::get<0>(dis), status_type::SUCCESS);
+  EXPECT_EQ(std::get<1>(dis).value(), prog);
+
+  EXPECT_EQ(evm.interpret(chunk), status_type::SUCCESS);
+  EXPECT_EQ(iset.written, std::vector<ui32>{7});
+
+  iset.written.clear();
+  EXPECT_EQ(evm.load(chunk), status_type::SUCCESS);
+  EXPECT_EQ(evm.run(), status_type::SUCCESS);
+  EXPECT_EQ(iset.written, std::vector<ui32>{7});
+
+  // escape byte without extended opcode
+  prog_chunk bad;
+  bad.code = {0xFF};
+  EXPECT_EQ(evm.interpret(bad), status_type::CODE_OVERFLOW);
+}
+
+TEST_F(vm_test, interpret_pipes) {
+  std::istringstream sstr("push 5\npush 6\npop\nwrite");
+  auto res = vm6.assemble(sstr);
+  ASSERT_EQ(std::get<0>(res), status_type::SUCCESS);
+  EXPECT_EQ(vm6.interpret(std::get<1>(res).value()), status_type::SUCCESS);
+  EXPECT_EQ(iset6.written, std::vector<ui32>{5});
+
+  std::istringstream sstr_empty("push 5\npop\npop");
+  auto res_empty = vm6.assemble(sstr_empty);
+  ASSERT_EQ(std::get<0>(res_empty), status_type::SUCCESS);
+  EXPECT_EQ(vm6.interpret(std::get<1>(res_empty).value()),
+            status_type::POP_EMPTY_STACK);
+
+  // operand past the end of the chunk
+  prog_chunk bad;
+  bad.code = {0, 1, 0};
+  EXPECT_EQ(vm6.interpret(bad), status_type::CODE_OVERFLOW);
+}
+
+TEST_F(vm_test, opcode_profile) {
+  std::istringstream sstr(
+      "push 3\ndup\nwrite\npush 1\nsub\ndup\njz 24\njump 5\npop");
+  auto res = vm6.assemble(sstr);
+  ASSERT_EQ(std::get<0>(res), status_type::SUCCESS);
+  auto const &chunk = std::get<1>(res).value();
+
+  vm6_type::opcode_profile_type profile;
+  EXPECT_EQ(vm6.interpret(chunk, profile), status_type::SUCCESS);
+  std::array<std::uint64_t, 11> exp_counts = {4, 1, 6, 0, 3, 3, 2, 3, 0, 0, 0};
+  EXPECT_EQ(profile.counts, exp_counts);
+
+  std::ostringstream header;
+  write_opcode_profile(header, "mvm::test::test_instr_set_loop", profile);
+  EXPECT_NE(header.str().find("template <> struct mvm::traits::opcode_counts<"
+                              "mvm::test::test_instr_set_loop> {"),
+            std::string::npos);
+  EXPECT_NE(header.str().find("value = {4u, 1u, 6u, 0u, 3u, 3u, 2u, 3u, 0u, "
+                              "0u, 0u};"),
+            std::string::npos);
+
+  // instructions never run by the profile are moved to the cold code
+  using prof_traits = traits::instr_set_traits<test_instr_set_prof>;
+  static_assert(prof_traits::has_opcode_profile &&
+                    prof_traits::instr_hot_order[0] == 2 &&
+                    prof_traits::instr_hot[0] && !prof_traits::instr_hot[3] &&
+                    !prof_traits::is_hot_instr<list::at_t<
+                        3, test_instr_set_prof::instr_table>>,
+                "[-][vm_test] bad opcode profile");
+  static_assert(!traits::instr_set_traits<test_instr_set_loop>::
+                    has_opcode_profile,
+                "[-][vm_test] bad opcode profile");
+
+  // an empty profile does not move anything to the cold code
+  using empty_traits = traits::instr_set_traits<test_instr_set_empty_prof>;
+  static_assert(empty_traits::has_opcode_profile,
+                "[-][vm_test] bad opcode profile");
+  EXPECT_EQ(empty_traits::instr_hot, (std::array<bool, 11>{
+                                         true, true, true, true, true, true,
+                                         true, true, true, true, true}));
+
+  test_instr_set_prof iset;
+  vm<test_instr_set_prof> pvm{iset};
+  std::istringstream sstr_cold("push 3\npush 4\nadd\nwrite");
+  auto res_cold = pvm.assemble(sstr_cold);
+  ASSERT_EQ(std::get<0>(res_cold), status_type::SUCCESS);
+  EXPECT_EQ(pvm.interpret(std::get<1>(res_cold).value()),
+            status_type::SUCCESS);
+  EXPECT_EQ(iset.written, std::vector<ui32>{7});
+}
+
 TEST_F(vm_test, interpret_prog) {
   // push 1
   // dup
@@ -166,6 +770,88 @@ TEST_F(vm_test, interpret_prog) {
   // 3 not in the stack as it is a direct pipe instruction
   std::vector<unsigned> exp_stack = {2, 0, 4, 5, 1, 0};
   EXPECT_EQ(iset1.call_stack, exp_stack);
+
+  // same calls from the register interpreter
+  prog_chunk chunk{{0x3, 0x1, 0x0, 0x0, 0x0, 0x2, 0x0, 0x4, 0x2, 0x0, 0x0, 0x0,
+                    0x5, 0x3, 0x0, 0x0, 0x0, 0x1, 0x17, 0x0, 0x0, 0x0, 0x90,
+                    0x0}};
+  iset1.call_stack.clear();
+  EXPECT_EQ(vm1.load(chunk), status_type::SUCCESS);
+  EXPECT_EQ(vm1.run(), status_type::SUCCESS);
+  EXPECT_EQ(iset1.call_stack, exp_stack);
+}
+
+TEST_F(vm_test, interpret_mapped_stack) {
+  using mapped_instances_list =
+      list::mplist<meta_bytecode<bytecode_serializer>,
+                   meta_value_stack<mapped_value_stack<list::mplist<ui32>, 4>>>;
+  test_instr_set iset;
+  vm<test_instr_set, mapped_instances_list> mvm{iset};
+
+  // push 1 and 2 then add
+  EXPECT_EQ(mvm.interpret(prog_chunk(
+                {0x3, 0x1, 0x0, 0x0, 0x0, 0x3, 0x2, 0x0, 0x0, 0x0, 0x6})),
+            status_type::SUCCESS);
+
+  // randn 5 overflows the stack
+  EXPECT_EQ(mvm.interpret(prog_chunk({0x4, 0x5, 0x0, 0x0, 0x0})),
+            status_type::PUSH_FULL_STACK);
+}
+
+TEST_F(vm_test, assemble_interpret_pmr) {
+  using pmr_instances_list =
+      list::mplist<meta_bytecode<bytecode_serializer>,
+                   meta_value_stack<mvm::pmr::value_stack<list::mplist<ui32>>>>;
+
+  std::array<std::byte, 4096> buffer;
+  std::pmr::monotonic_buffer_resource res{buffer.data(), buffer.size(),
+                                          std::pmr::null_memory_resource()};
+
+  test_instr_set iset;
+  vm<test_instr_set, pmr_instances_list> mvm{iset, &res};
+
+  std::istringstream sstr("push 1\npush 2\nadd\nrandn 3\nrotln 3");
+  auto res_asm = mvm.assemble(sstr, &res);
+  ASSERT_EQ(std::get<0>(res_asm), status_type::SUCCESS);
+
+  auto const &chunk = std::get<1>(res_asm).value();
+  EXPECT_EQ(chunk.code.get_allocator().resource(), &res);
+  EXPECT_EQ(chunk.code.size(), 21u);
+
+  EXPECT_EQ(mvm.interpret(chunk), status_type::SUCCESS);
+  std::vector<unsigned> exp_stack = {6, 4, 5};
+  EXPECT_EQ(iset.call_stack, exp_stack);
+}
+
+TEST_F(vm_test, interpret_profiled_stack) {
+  using profiled_instances_list = list::mplist<
+      meta_bytecode<bytecode_serializer>,
+      meta_value_stack<profiled_stack<value_stack<list::mplist<ui32>>>>>;
+  using vm_type = vm<test_instr_set, profiled_instances_list>;
+
+  test_instr_set iset;
+  vm_type mvm{iset};
+  vm_type::stack_profile_type profile;
+
+  // push 1, push 2, add, rotln 1
+  prog_chunk chunk({0x3, 0x1, 0x0, 0x0, 0x0, 0x3, 0x2, 0x0, 0x0, 0x0, 0x6, 0x5,
+                    0x1, 0x0, 0x0, 0x0});
+  EXPECT_EQ(mvm.interpret(chunk, profile), status_type::SUCCESS);
+  EXPECT_EQ(profile.high_water[0], 0u);
+  EXPECT_EQ(profile.high_water[1], 2u);
+  EXPECT_TRUE(profile.grown);
+
+  // same run with the recorded profile
+  profile.grown = false;
+  EXPECT_EQ(mvm.interpret(chunk, profile), status_type::SUCCESS);
+  EXPECT_EQ(profile.high_water[1], 2u);
+  EXPECT_FALSE(profile.grown);
+
+  // randn 3 goes deeper than a fixed capacity
+  profile.fixed_capacity = true;
+  EXPECT_EQ(mvm.interpret(prog_chunk({0x4, 0x3, 0x0, 0x0, 0x0}), profile),
+            status_type::PUSH_FULL_STACK);
+  EXPECT_EQ(profile.high_water[1], 2u);
 }
 
 TEST_F(vm_test, interpret_bad) {